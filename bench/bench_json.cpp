@@ -0,0 +1,108 @@
+#include "bench_util.h"
+#include "cbor.h"
+#include "parallel_parse.h"
+
+// 每个语料一组: 解析(三种DOM和只建索引),输出(文本和CBOR); SetBytesProcessed按输入JSON的大小算,报告里就是MB/s
+
+namespace bench {
+
+    namespace {
+        void parse_node(benchmark::State& state, const Corpus& c) {
+            AllocCounter allocs{ state };
+            for (auto _ : state) {
+                auto node = json::parser(c.text);
+                benchmark::DoNotOptimize(node);
+            }
+            state.SetBytesProcessed(std::int64_t(state.iterations() * c.text.size()));
+        }
+
+        void parse_document(benchmark::State& state, const Corpus& c, bool zero_copy) {
+            AllocCounter allocs{ state };
+            for (auto _ : state) {
+                auto doc = json::parse_document(c.text, { zero_copy });
+                benchmark::DoNotOptimize(doc);
+            }
+            state.SetBytesProcessed(std::int64_t(state.iterations() * c.text.size()));
+        }
+
+        void parse_document_parallel(benchmark::State& state, const Corpus& c) {
+            ThreadPool pool(int(std::max(1u, std::thread::hardware_concurrency())));
+            AllocCounter allocs{ state };
+            for (auto _ : state) {
+                auto doc = json::parse_document_parallel(pool, c.text, { 1 << 20, 0, { true } });
+                benchmark::DoNotOptimize(doc);
+            }
+            state.SetBytesProcessed(std::int64_t(state.iterations() * c.text.size()));
+        }
+
+        void structural_index(benchmark::State& state, const Corpus& c) {  // 只跑stage 1
+            json::StructuralIndex index;
+            AllocCounter allocs{ state };
+            for (auto _ : state) {
+                benchmark::DoNotOptimize(json::build_structural_index(c.text, index));
+            }
+            state.SetBytesProcessed(std::int64_t(state.iterations() * c.text.size()));
+        }
+
+        void generate_node(benchmark::State& state, const Corpus& c) {
+            auto node = json::parser(c.text).value();
+            AllocCounter allocs{ state };
+            for (auto _ : state) {
+                auto out = json::generate(node);
+                benchmark::DoNotOptimize(out);
+            }
+            state.SetBytesProcessed(std::int64_t(state.iterations() * c.text.size()));
+        }
+
+        void write_document(benchmark::State& state, const Corpus& c) {  // 复用同一个JsonWriter的缓冲区
+            auto doc = json::parse_document(c.text).value();
+            json::JsonWriter writer;
+            AllocCounter allocs{ state };
+            for (auto _ : state) {
+                writer.clear();
+                writer.write(doc.root);
+                benchmark::DoNotOptimize(writer.str().data());
+            }
+            state.SetBytesProcessed(std::int64_t(state.iterations() * c.text.size()));
+        }
+
+        void cbor_encode(benchmark::State& state, const Corpus& c) {
+            auto node = json::parser(c.text).value();
+            json::CborWriter writer;
+            AllocCounter allocs{ state };
+            for (auto _ : state) {
+                writer.clear();
+                writer.write(node);
+                benchmark::DoNotOptimize(writer.str().data());
+            }
+            state.SetBytesProcessed(std::int64_t(state.iterations() * c.text.size()));
+            state.counters["cbor_bytes"] = double(writer.str().size());
+        }
+
+        void cbor_decode(benchmark::State& state, const Corpus& c) {
+            auto bin = json::to_cbor(json::parser(c.text).value());
+            AllocCounter allocs{ state };
+            for (auto _ : state) {
+                auto node = json::from_cbor(bin);
+                benchmark::DoNotOptimize(node);
+            }
+            state.SetBytesProcessed(std::int64_t(state.iterations() * c.text.size()));
+        }
+    }
+
+    void register_json_benchmarks() {
+        for (const auto& c : corpora()) {
+            const Corpus* p = &c;  // corpora()是静态的,指针一直有效
+            benchmark::RegisterBenchmark(("json/parse_node/" + c.name).c_str(), [p](benchmark::State& s) { parse_node(s, *p); });
+            benchmark::RegisterBenchmark(("json/parse_document/" + c.name).c_str(), [p](benchmark::State& s) { parse_document(s, *p, false); });
+            benchmark::RegisterBenchmark(("json/parse_document_zero_copy/" + c.name).c_str(), [p](benchmark::State& s) { parse_document(s, *p, true); });
+            benchmark::RegisterBenchmark(("json/parse_document_parallel/" + c.name).c_str(), [p](benchmark::State& s) { parse_document_parallel(s, *p); })->UseRealTime();
+            benchmark::RegisterBenchmark(("json/structural_index/" + c.name).c_str(), [p](benchmark::State& s) { structural_index(s, *p); });
+            benchmark::RegisterBenchmark(("json/generate_node/" + c.name).c_str(), [p](benchmark::State& s) { generate_node(s, *p); });
+            benchmark::RegisterBenchmark(("json/write_document/" + c.name).c_str(), [p](benchmark::State& s) { write_document(s, *p); });
+            benchmark::RegisterBenchmark(("json/cbor_encode/" + c.name).c_str(), [p](benchmark::State& s) { cbor_encode(s, *p); });
+            benchmark::RegisterBenchmark(("json/cbor_decode/" + c.name).c_str(), [p](benchmark::State& s) { cbor_decode(s, *p); });
+        }
+    }
+
+}
@@ -0,0 +1,121 @@
+#include "bench_util.h"
+#include "json.h"
+#include <cstdlib>
+#include <new>
+
+// 全局operator new/delete换成计数的版本; 只计次数,不改变分配行为
+
+std::atomic<size_t> bench::allocation_count{ 0 };
+
+void* operator new(size_t size) {
+    bench::allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc{};
+}
+void* operator new[](size_t size) { return ::operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    bench::allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept { return ::operator new(size, tag); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+namespace bench {
+
+    namespace {
+        std::string data_dir() {
+            if (const char* dir = std::getenv("JSON_BENCH_DATA"))
+                return dir;
+#if defined(JSON_BENCH_DATA_DIR)
+            return JSON_BENCH_DATA_DIR;
+#else
+            return "bench/data";
+#endif
+        }
+
+        // 几种典型的形状,大小都在几MB: 和标准语料一样覆盖对象/字符串为主和数字为主两种情况
+        std::string synthetic_records(size_t n) {  // 类似twitter.json: 对象数组,字符串多,带转义和非ASCII
+            json::JsonWriter w;
+            w.start_array();
+            for (size_t i = 0; i < n; i++) {
+                w.start_object();
+                w.on_key("id");
+                w.on_int(json::Int(1000000007 * i));
+                w.on_key("user");
+                w.on_string("user_" + std::to_string(i % 977));
+                w.on_key("text");
+                w.on_string("RT @someone: \"quoted\" text with a tab\tand unicode \xe4\xbd\xa0\xe5\xa5\xbd #" + std::to_string(i));
+                w.on_key("retweets");
+                w.on_int(json::Int(i % 131));
+                w.on_key("verified");
+                w.on_bool(i % 3 == 0);
+                w.on_key("reply_to");
+                w.on_null();
+                w.on_key("tags");
+                w.start_array();
+                for (size_t t = 0; t < i % 4; t++)
+                    w.on_string("tag" + std::to_string(t));
+                w.end_array();
+                w.end_object();
+            }
+            w.end_array();
+            return w.take();
+        }
+
+        std::string synthetic_numbers(size_t n) {  // 类似canada.json: 嵌套的坐标数组,几乎全是浮点数
+            json::JsonWriter w;
+            w.start_object();
+            w.on_key("type");
+            w.on_string("Polygon");
+            w.on_key("coordinates");
+            w.start_array();
+            std::uint64_t seed = 42;
+            for (size_t i = 0; i < n; i++) {
+                w.start_array();
+                for (int k = 0; k < 2; k++) {
+                    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+                    w.on_float(-180.0 + 360.0 * double(seed >> 11) / double(1ULL << 53));
+                }
+                w.end_array();
+            }
+            w.end_array();
+            w.end_object();
+            return w.take();
+        }
+    }
+
+    const std::vector<Corpus>& corpora() {
+        static const std::vector<Corpus> all = [] {
+            std::vector<Corpus> out;
+            for (const char* name : { "twitter", "citm_catalog", "canada" }) {
+                std::string path = data_dir() + "/" + name + ".json";
+                try {
+                    json::MappedFile file{ path };
+                    out.push_back({ name, std::string{ file.view() } });
+                }
+                catch (const std::exception&) {
+                    std::fprintf(stderr, "bench: %s not found, skipping\n", path.c_str());
+                }
+            }
+            out.push_back({ "synthetic_records", synthetic_records(20000) });
+            out.push_back({ "synthetic_numbers", synthetic_numbers(100000) });
+            return out;
+        }();
+        return all;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    bench::register_json_benchmarks();  // 语料是运行时读进来的,按语料注册; 线程池的在bench_threadpool.cpp里静态注册
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
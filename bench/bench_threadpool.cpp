@@ -0,0 +1,182 @@
+#include "bench_util.h"
+#include "threadpool.h"
+#include <chrono>
+#if defined(THREADPOOL_COROUTINES)
+#include "coro.h"
+#endif
+
+// 线程池: 单个任务的往返延迟,不同线程数和任务大小下的吞吐(tasks/s),以及每个任务的分配次数
+// 都是多线程的,用墙上时间(UseRealTime),否则只算了提交线程自己的CPU时间
+
+namespace bench {
+
+    namespace {
+        void spin_for(std::int64_t ns) {  // 模拟任务本身的工作量
+            if (ns <= 0)
+                return;
+            auto until = std::chrono::steady_clock::now() + std::chrono::nanoseconds(ns);
+            while (std::chrono::steady_clock::now() < until) {
+            }
+        }
+
+        void wait_for(const std::atomic<size_t>& done, size_t n) {
+            while (done.load(std::memory_order_acquire) < n)
+                std::this_thread::yield();
+        }
+
+        constexpr size_t batch = 1000;  // 吞吐测试里每次迭代提交的任务数
+    }
+
+    // range(0): 线程数
+    void BM_submit_latency(benchmark::State& state) {  // submit一个空任务再get,提交->执行->唤醒的往返
+        ThreadPool pool(int(state.range(0)));
+        AllocCounter allocs{ state };
+        for (auto _ : state) {
+            pool.submit([] { return 1; }).get();
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_submit_latency)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+    // range(0): 线程数, range(1): 每个任务的工作量(ns)
+    void BM_submit_throughput(benchmark::State& state) {
+        ThreadPool pool(int(state.range(0)));
+        std::int64_t work = state.range(1);
+        std::vector<std::future<void>> futures;
+        futures.reserve(batch);
+        AllocCounter allocs{ state };
+        for (auto _ : state) {
+            futures.clear();
+            for (size_t i = 0; i < batch; i++)
+                futures.push_back(pool.submit([work] { spin_for(work); }));
+            for (auto& f : futures)
+                f.get();
+        }
+        state.SetItemsProcessed(std::int64_t(state.iterations() * batch));
+    }
+    BENCHMARK(BM_submit_throughput)->ArgsProduct({ { 1, 2, 4, 8 }, { 0, 1000, 10000 } })->UseRealTime();
+
+    void BM_post_throughput(benchmark::State& state) {  // 没有future
+        ThreadPool pool(int(state.range(0)));
+        std::int64_t work = state.range(1);
+        std::atomic<size_t> done{ 0 };
+        AllocCounter allocs{ state };
+        for (auto _ : state) {
+            done.store(0, std::memory_order_relaxed);
+            for (size_t i = 0; i < batch; i++)
+                pool.post([work, &done] { spin_for(work); done.fetch_add(1, std::memory_order_release); });
+            wait_for(done, batch);
+        }
+        state.SetItemsProcessed(std::int64_t(state.iterations() * batch));
+    }
+    BENCHMARK(BM_post_throughput)->ArgsProduct({ { 1, 2, 4, 8 }, { 0, 1000, 10000 } })->UseRealTime();
+
+    void BM_post_batch_throughput(benchmark::State& state) {  // 一次入队,一次唤醒
+        ThreadPool pool(int(state.range(0)));
+        std::int64_t work = state.range(1);
+        std::atomic<size_t> done{ 0 };
+        std::vector<std::function<void()>> tasks(batch, [work, &done] { spin_for(work); done.fetch_add(1, std::memory_order_release); });
+        AllocCounter allocs{ state };
+        for (auto _ : state) {
+            done.store(0, std::memory_order_relaxed);
+            pool.post_batch(tasks);
+            wait_for(done, batch);
+        }
+        state.SetItemsProcessed(std::int64_t(state.iterations() * batch));
+    }
+    BENCHMARK(BM_post_batch_throughput)->ArgsProduct({ { 1, 2, 4, 8 }, { 0, 1000 } })->UseRealTime();
+
+    void BM_work_stealing_fanout(benchmark::State& state) {  // worker里再提交子任务: 走本地队列和偷任务的路径
+        pool_options o;
+        o.work_stealing = true;
+        ThreadPool pool(int(state.range(0)), o);
+        std::atomic<size_t> done{ 0 };
+        constexpr size_t parents = 32;
+        constexpr size_t children = batch / parents;
+        AllocCounter allocs{ state };
+        for (auto _ : state) {
+            done.store(0, std::memory_order_relaxed);
+            for (size_t i = 0; i < parents; i++) {
+                pool.post([&pool, &done] {
+                    for (size_t k = 0; k < children; k++)
+                        pool.post([&done] { done.fetch_add(1, std::memory_order_release); });
+                });
+            }
+            wait_for(done, parents * children);
+        }
+        state.SetItemsProcessed(std::int64_t(state.iterations() * parents * children));
+    }
+    BENCHMARK(BM_work_stealing_fanout)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+    void BM_parallel_reduce(benchmark::State& state) {  // 调用线程也参与计算
+        ThreadPool pool(int(state.range(0)));
+        std::vector<std::uint32_t> data(1 << 22);
+        for (size_t i = 0; i < data.size(); i++)
+            data[i] = std::uint32_t(i * 2654435761u);
+        AllocCounter allocs{ state };
+        for (auto _ : state) {
+            auto sum = pool.parallel_reduce(size_t(0), data.size(), size_t(0), std::uint64_t(0),
+                [&](size_t b, size_t e) { std::uint64_t s = 0; for (size_t i = b; i < e; i++) s += data[i]; return s; },
+                [](std::uint64_t a, std::uint64_t b) { return a + b; });
+            benchmark::DoNotOptimize(sum);
+        }
+        state.SetBytesProcessed(std::int64_t(state.iterations() * data.size() * sizeof(data[0])));
+    }
+    BENCHMARK(BM_parallel_reduce)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+    void BM_graph_fanout(benchmark::State& state) {  // async -> batch个then -> when_all -> then, 只有最外层的get()在等
+        ThreadPool pool(int(state.range(0)));
+        std::vector<graph_node<std::uint64_t>> parts(batch);
+        AllocCounter allocs{ state };
+        for (auto _ : state) {
+            auto root = pool.async([] { return std::uint64_t(1); });
+            for (size_t i = 0; i < batch; i++)
+                parts[i] = pool.then(root, [i](const std::uint64_t& x) { return x + i; });
+            auto sum = pool.then(pool.when_all(parts), [](const std::vector<std::uint64_t>& v) {
+                std::uint64_t s = 0;
+                for (auto x : v)
+                    s += x;
+                return s;
+            });
+            benchmark::DoNotOptimize(sum.get());
+        }
+        state.SetItemsProcessed(std::int64_t(state.iterations() * batch));
+    }
+    BENCHMARK(BM_graph_fanout)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+#if defined(THREADPOOL_COROUTINES)
+    void BM_coroutine_hops(benchmark::State& state) {  // 一个协程在worker之间来回co_await pool.schedule(); 每次跳转就是一次post
+        ThreadPool pool(int(state.range(0)));
+        auto hops = [&pool]() -> coro::task<void> {
+            for (size_t i = 0; i < batch; i++)
+                co_await pool.schedule();
+        };
+        AllocCounter allocs{ state };
+        for (auto _ : state) {
+            coro::sync_wait(hops());
+        }
+        state.SetItemsProcessed(std::int64_t(state.iterations() * batch));
+    }
+    BENCHMARK(BM_coroutine_hops)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+
+    void BM_coroutine_fanout(benchmark::State& state) {  // batch个互相独立的协程同时挂在pool上,全部结束后sync_wait返回
+        ThreadPool pool(int(state.range(0)));
+        std::atomic<size_t> done{ 0 };
+        auto step = [&pool, &done]() -> coro::task<void> {
+            co_await pool.schedule();
+            co_await pool.schedule();  // 中间挂起一次,模拟依赖前一步的第二步
+            done.fetch_add(1, std::memory_order_release);
+        };
+        AllocCounter allocs{ state };
+        for (auto _ : state) {
+            done.store(0, std::memory_order_relaxed);
+            for (size_t i = 0; i < batch; i++)
+                coro::spawn(step());
+            wait_for(done, batch);
+        }
+        state.SetItemsProcessed(std::int64_t(state.iterations() * batch));
+    }
+    BENCHMARK(BM_coroutine_fanout)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+#endif
+
+}
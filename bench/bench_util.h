@@ -0,0 +1,38 @@
+#pragma once
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// bench用到的公共部分: 分配计数和测试语料
+
+namespace bench {
+
+    // bench_main.cpp替换了全局的operator new,每次分配都在这里加一
+    extern std::atomic<size_t> allocation_count;
+
+    inline size_t allocations() { return allocation_count.load(std::memory_order_relaxed); }
+
+    class AllocCounter {  // 放在计时循环外面: 结束时把平均每次迭代的分配次数记进state.counters["allocs"]
+    public:
+        explicit AllocCounter(benchmark::State& _state) : state(_state), start(allocations()) {}
+        ~AllocCounter() {
+            state.counters["allocs"] = benchmark::Counter(double(allocations() - start), benchmark::Counter::kAvgIterations);
+        }
+    private:
+        benchmark::State& state;
+        size_t start;
+    };
+
+    struct Corpus {
+        std::string name;
+        std::string text;
+    };
+
+    // 数据目录里找得到的标准语料(twitter, citm_catalog, canada),加上几个总是存在的生成语料
+    const std::vector<Corpus>& corpora();
+
+    void register_json_benchmarks();
+
+}
@@ -0,0 +1,378 @@
+#pragma once
+#include "json.h"
+
+// CBOR(RFC 8949)编解码: 服务之间传Node的时候不用再输出成文本,对面再解析一遍
+// 数组/对象/字符串前面都带着长度,解码时直接reserve; 浮点数按二进制原样存,不用格式化和from_chars
+// 只用到和JSON对应的那部分CBOR: 整数,浮点数,文本,数组,key是文本的map,false/true/null
+
+namespace json {
+
+    class CborWriter {
+    public:
+        const std::string& str() const { return buf; }
+        std::string take() {
+            std::string out = std::move(buf);
+            buf.clear();
+            return out;
+        }
+        void clear() { buf.clear(); }
+
+        // 整棵树已经在手里: 数组和对象都写成定长的
+        void write(const Node& node) {
+            std::visit([this](auto&& arg) { write(arg); }, node.value);
+        }
+        void write(Null) { on_null(); }
+        void write(Bool v) { on_bool(v); }
+        void write(Int v) { on_int(v); }
+        void write(Float v) { on_float(v); }
+        void write(const String& v) { on_string(v); }
+        void write(const Array& array) {
+            write_head(4, array.size());
+            for (const auto& node : array) {
+                write(node);
+            }
+        }
+        void write(const Object& object) {
+            write_head(5, object.size());
+            for (const auto& [key, node] : object) {
+                on_key(key);
+                write(node);
+            }
+        }
+        void write(const ArenaNode& node) {
+            switch (node.type()) {
+                case Type::Null: on_null(); break;
+                case Type::Bool: on_bool(node.b); break;
+                case Type::Int: on_int(node.i); break;
+                case Type::Float: on_float(node.f); break;
+                case Type::String: on_string(node.as_string()); break;
+                case Type::Array:
+                    write_head(4, node.size());
+                    for (const auto& item : node.elements()) {
+                        write(item);
+                    }
+                    break;
+                case Type::Object:
+                    write_head(5, node.size());
+                    for (const auto& [key, value] : node.fields()) {
+                        on_key(key);
+                        write(value);
+                    }
+                    break;
+            }
+        }
+
+        // Handler接口: parse_events(json_str, writer)直接把JSON文本转成CBOR,不构造Node
+        // 事件里拿不到元素个数,数组和对象写成不定长的(0x9F/0xBF ... 0xFF)
+        bool on_null() {
+            buf += char(0xF6);
+            return true;
+        }
+        bool on_bool(Bool v) {
+            buf += char(v ? 0xF5 : 0xF4);
+            return true;
+        }
+        bool on_int(Int v) {
+            if (v >= 0) {
+                write_head(0, std::uint64_t(v));
+            }
+            else {
+                write_head(1, ~std::uint64_t(v));  // -1-v,不经过有符号溢出
+            }
+            return true;
+        }
+        bool on_float(Float v) {  // float能精确表示的(包括inf)写成4字节,NaN和其余的写成8字节
+            // 超出float范围的double转换成float是未定义行为,先检查范围再比较转换回来的值
+            bool in_range = std::isinf(v) || std::fabs(v) <= Float(std::numeric_limits<float>::max());
+            float f = in_range ? float(v) : 0.0f;
+            if (in_range && Float(f) == v) {
+                std::uint32_t bits;
+                std::memcpy(&bits, &f, sizeof(bits));
+                buf += char(0xFA);
+                write_be(bits, 4);
+            }
+            else {
+                std::uint64_t bits;
+                std::memcpy(&bits, &v, sizeof(bits));
+                buf += char(0xFB);
+                write_be(bits, 8);
+            }
+            return true;
+        }
+        bool on_string(std::string_view str) {
+            write_head(3, str.size());
+            buf += str;
+            return true;
+        }
+        bool on_key(std::string_view key) { return on_string(key); }
+        bool start_array() {
+            buf += char(0x9F);
+            return true;
+        }
+        bool start_object() {
+            buf += char(0xBF);
+            return true;
+        }
+        bool end_array() {
+            buf += char(0xFF);
+            return true;
+        }
+        bool end_object() { return end_array(); }
+
+    private:
+        void write_head(int major, std::uint64_t n) {  // 类型和长度(或者整数值本身),按大小选最短的编码
+            char type = char(major << 5);
+            if (n < 24) {
+                buf += char(type | char(n));
+            }
+            else if (n <= 0xFF) {
+                buf += char(type | 24);
+                write_be(n, 1);
+            }
+            else if (n <= 0xFFFF) {
+                buf += char(type | 25);
+                write_be(n, 2);
+            }
+            else if (n <= 0xFFFFFFFF) {
+                buf += char(type | 26);
+                write_be(n, 4);
+            }
+            else {
+                buf += char(type | 27);
+                write_be(n, 8);
+            }
+        }
+        void write_be(std::uint64_t v, int bytes) {
+            char tmp[8];
+            for (int i = bytes - 1; i >= 0; i--) {
+                tmp[i] = char(v & 0xFF);
+                v >>= 8;
+            }
+            buf.append(tmp, size_t(bytes));
+        }
+
+        std::string buf;
+    };
+
+    inline std::string to_cbor(const Node& node) {
+        CborWriter writer;
+        writer.write(node);
+        return writer.take();
+    }
+
+    inline std::string to_cbor(const ArenaNode& node) {
+        CborWriter writer;
+        writer.write(node);
+        return writer.take();
+    }
+
+    // 不抛异常,格式不对返回nullopt; 数据来自网络,长度字段不可信: reserve不超过剩下的字节数,嵌套深度有上限
+    class CborReader {
+    public:
+        explicit CborReader(std::string_view _data) : data(_data) {}
+
+        std::optional<Node> read() {
+            Node node;
+            if (!read_value(node, 0)) {
+                return {};
+            }
+            return node;
+        }
+        size_t position() const { return pos; }
+        bool at_end() const { return pos == data.size(); }
+
+        static constexpr size_t max_depth = 1024;
+
+    private:
+        static constexpr std::uint64_t indefinite = ~std::uint64_t(0);
+
+        bool read_be(int bytes, std::uint64_t& out) {
+            if (data.size() - pos < size_t(bytes)) {
+                return false;
+            }
+            out = 0;
+            for (int i = 0; i < bytes; i++) {
+                out = (out << 8) | std::uint8_t(data[pos++]);
+            }
+            return true;
+        }
+
+        // 读一个头: 返回major类型,arg是长度/整数值,不定长时是indefinite; info是低5位(浮点数要用)
+        bool read_head(int& major, int& info, std::uint64_t& arg) {
+            if (pos >= data.size()) {
+                return false;
+            }
+            std::uint8_t head = std::uint8_t(data[pos++]);
+            major = head >> 5;
+            info = head & 0x1F;
+            if (info < 24) {
+                arg = std::uint64_t(info);
+                return true;
+            }
+            if (info <= 27) {
+                return read_be(1 << (info - 24), arg);
+            }
+            if (info == 31 && (major >= 2 && major != 6)) {  // 不定长字符串/数组/map,或者major 7的break
+                arg = indefinite;
+                return true;
+            }
+            return false;  // 28-30保留
+        }
+
+        bool read_string(int major, std::uint64_t len, std::string& out) {  // 文本和字节串都当作String
+            if (len != indefinite) {
+                if (len > data.size() - pos) {
+                    return false;
+                }
+                out.append(data.data() + pos, size_t(len));
+                pos += size_t(len);
+                return true;
+            }
+            while (true) {  // 不定长: 若干个同类型的定长块,以break结束
+                int chunk_major, info;
+                std::uint64_t chunk_len;
+                if (!read_head(chunk_major, info, chunk_len)) {
+                    return false;
+                }
+                if (chunk_major == 7 && chunk_len == indefinite) {
+                    return true;
+                }
+                if (chunk_major != major || chunk_len == indefinite || !read_string(major, chunk_len, out)) {
+                    return false;
+                }
+            }
+        }
+
+        bool is_break() const {
+            return pos < data.size() && std::uint8_t(data[pos]) == 0xFF;
+        }
+
+        static Float half_to_float(std::uint64_t h) {
+            int exp = int((h >> 10) & 0x1F);
+            int mant = int(h & 0x3FF);
+            Float v = exp == 0 ? std::ldexp(mant, -24) : exp != 31 ? std::ldexp(mant + 1024, exp - 25) : mant == 0 ? std::numeric_limits<Float>::infinity() : std::numeric_limits<Float>::quiet_NaN();
+            return (h & 0x8000) ? -v : v;
+        }
+
+        bool read_value(Node& out, size_t depth) {
+            if (depth > max_depth) {
+                return false;
+            }
+            int major, info;
+            std::uint64_t arg;
+            if (!read_head(major, info, arg)) {
+                return false;
+            }
+            constexpr auto max = std::uint64_t(std::numeric_limits<Int>::max());
+            switch (major) {
+                case 0:  // 放不下int64_t的和JSON解析一样变成Float
+                    out.value = arg <= max ? Value{ Int(arg) } : Value{ Float(arg) };
+                    return true;
+                case 1:
+                    out.value = arg <= max ? Value{ Int(~arg) } : Value{ -1.0 - Float(arg) };
+                    return true;
+                case 2:
+                case 3: {
+                    String str;
+                    if (!read_string(major, arg, str)) {
+                        return false;
+                    }
+                    out.value = std::move(str);
+                    return true;
+                }
+                case 4: {
+                    Array array;
+                    if (arg != indefinite) {
+                        array.reserve(size_t(std::min<std::uint64_t>(arg, data.size() - pos)));  // 每个元素至少1字节
+                        for (std::uint64_t i = 0; i < arg; i++) {
+                            if (!read_value(array.emplace_back(), depth + 1)) {
+                                return false;
+                            }
+                        }
+                    }
+                    else {
+                        while (!is_break()) {
+                            if (!read_value(array.emplace_back(), depth + 1)) {
+                                return false;
+                            }
+                        }
+                        pos++;  // break
+                    }
+                    out.value = std::move(array);
+                    return true;
+                }
+                case 5: {
+                    Object object;
+#if defined(JSON_FLAT_OBJECT)
+                    if (arg != indefinite) {
+                        object.reserve(size_t(std::min<std::uint64_t>(arg, (data.size() - pos) / 2)));  // 每个成员至少2字节
+                    }
+#endif
+                    String key;
+                    for (std::uint64_t i = 0; arg == indefinite ? !is_break() : i < arg; i++) {
+                        int key_major, key_info;
+                        std::uint64_t key_len;
+                        if (!read_head(key_major, key_info, key_len) || key_major != 3) {  // JSON的key只能是文本
+                            return false;
+                        }
+                        key.clear();
+                        if (!read_string(3, key_len, key)) {
+                            return false;
+                        }
+                        Node value;
+                        if (!read_value(value, depth + 1)) {
+                            return false;
+                        }
+                        object[key] = std::move(value);  // 重复的key和JSON解析一样后面的覆盖前面的
+                    }
+                    if (arg == indefinite) {
+                        if (!is_break()) {
+                            return false;
+                        }
+                        pos++;  // break
+                    }
+                    out.value = std::move(object);
+                    return true;
+                }
+                case 6:  // tag: 忽略,只要后面的值
+                    return read_value(out, depth + 1);
+                default:  // 7: 简单值和浮点数
+                    switch (info) {
+                        case 20: out.value = false; return true;
+                        case 21: out.value = true; return true;
+                        case 22:
+                        case 23: out.value = Null{}; return true;  // null, undefined
+                        case 25: out.value = half_to_float(arg); return true;
+                        case 26: {
+                            std::uint32_t bits = std::uint32_t(arg);
+                            float f;
+                            std::memcpy(&f, &bits, sizeof(f));
+                            out.value = Float(f);
+                            return true;
+                        }
+                        case 27: {
+                            Float f;
+                            std::memcpy(&f, &arg, sizeof(f));
+                            out.value = f;
+                            return true;
+                        }
+                        default:
+                            return false;  // 其他简单值,或者不在容器里的break
+                    }
+            }
+        }
+
+        std::string_view data;
+        size_t pos = 0;
+    };
+
+    inline std::optional<Node> from_cbor(std::string_view data) {  // data必须恰好是一个值,后面不能有多余的字节
+        CborReader reader{ data };
+        auto node = reader.read();
+        if (!node || !reader.at_end()) {
+            return {};
+        }
+        return node;
+    }
+
+}
@@ -0,0 +1,169 @@
+#pragma once
+#include "threadpool.h"
+#include <exception>
+
+// C++20协程: task<T>是惰性的协程,被co_await时才开始执行,结束后直接切回等待它的协程(对称转移,不经过队列也不占线程)
+// co_await pool.schedule()把协程剩下的部分交给线程池的worker继续执行; 等待的一方不阻塞任何线程,
+// 所以几千个互相依赖的步骤可以同时挂在少数几个worker上
+// 队列满了(有容量上限,或者lockfree_queue的环形缓冲区放不下)co_await pool.schedule()不挂起,协程就在当前线程上继续,和post就地执行的效果一样但栈不会变深
+// 最外层用sync_wait(task)在普通线程上等结果(不要在pool自己的worker里调用),或者spawn(task)不等结果
+
+#if !defined(THREADPOOL_COROUTINES)
+#error "coro.h needs C++20 coroutines (-std=c++20)"
+#endif
+
+namespace coro {  // threadpool.h里已经有一个task(线程池内部的可调用对象),协程的这些都放在coro里
+
+    template<typename T = void>
+    class task;
+
+    namespace detail {
+
+        struct promise_base {
+            std::coroutine_handle<> continuation = std::noop_coroutine();  // 等待这个task的协程
+            std::exception_ptr error;
+
+            std::suspend_always initial_suspend() noexcept { return {}; }  // 惰性: 被co_await之前不执行
+            struct final_awaiter {
+                bool await_ready() const noexcept { return false; }
+                template<typename P>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept { return h.promise().continuation; }
+                void await_resume() const noexcept {}
+            };
+            final_awaiter final_suspend() noexcept { return {}; }
+            void unhandled_exception() { error = std::current_exception(); }  // 在co_await这个task的地方重新抛出
+        };
+
+        template<typename T>
+        struct promise : promise_base {
+            std::optional<T> value;
+            task<T> get_return_object() noexcept;
+            template<typename U>
+            void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+            T result() {
+                if (error)
+                    std::rethrow_exception(error);
+                return std::move(*value);
+            }
+        };
+
+        template<>
+        struct promise<void> : promise_base {
+            task<void> get_return_object() noexcept;
+            void return_void() {}
+            void result() {
+                if (error)
+                    std::rethrow_exception(error);
+            }
+        };
+
+        struct detached {  // 立即开始,结束时自己销毁; sync_wait和spawn的最外层
+            struct promise_type {
+                detached get_return_object() noexcept { return {}; }
+                std::suspend_never initial_suspend() noexcept { return {}; }
+                std::suspend_never final_suspend() noexcept { return {}; }
+                void return_void() {}
+                void unhandled_exception() { std::terminate(); }  // 和post一样,没人接的异常直接terminate
+            };
+        };
+
+    }
+
+    template<typename T>
+    class [[nodiscard]] task {
+    public:
+        static_assert(!std::is_reference_v<T>, "task<T&> is not supported, return a pointer instead");
+        using promise_type = detail::promise<T>;
+
+        task(task&& rhs) noexcept : h(std::exchange(rhs.h, nullptr)) {}
+        task& operator=(task&& rhs) noexcept {
+            if (this != &rhs) {
+                if (h)
+                    h.destroy();
+                h = std::exchange(rhs.h, nullptr);
+            }
+            return *this;
+        }
+        task(const task&) = delete;
+        task& operator=(const task&) = delete;
+        ~task() {
+            if (h)
+                h.destroy();
+        }
+
+        bool await_ready() const noexcept { return !h || h.done(); }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+            h.promise().continuation = awaiting;
+            return h;  // 直接开始执行这个task
+        }
+        T await_resume() { return h.promise().result(); }
+
+    private:
+        friend promise_type;
+        explicit task(std::coroutine_handle<promise_type> _h) : h(_h) {}
+        std::coroutine_handle<promise_type> h;
+    };
+
+    namespace detail {
+
+        template<typename T>
+        task<T> promise<T>::get_return_object() noexcept { return task<T>{ std::coroutine_handle<promise<T>>::from_promise(*this) }; }
+        inline task<void> promise<void>::get_return_object() noexcept { return task<void>{ std::coroutine_handle<promise<void>>::from_promise(*this) }; }
+
+        template<typename T>
+        struct sync_state {
+            std::mutex m;
+            std::condition_variable cv;
+            bool done = false;
+            std::conditional_t<std::is_void_v<T>, bool, std::optional<T>> value{};
+            std::exception_ptr error;
+        };
+
+        template<typename T>
+        detached sync_wait_impl(task<T>& t, sync_state<T>& st) {  // 参数都是引用,sync_wait在st.done之前不会返回
+            try {
+                if constexpr (std::is_void_v<T>)
+                    co_await t;
+                else
+                    st.value.emplace(co_await t);
+            }
+            catch (...) {
+                st.error = std::current_exception();
+            }
+            std::unique_lock<std::mutex> lock(st.m);  // 持有锁通知: 等待的一方拿到锁之后st才可能被销毁
+            st.done = true;
+            st.cv.notify_one();
+        }
+
+        inline detached spawn_impl(task<void> t) {
+            co_await t;
+        }
+
+    }
+
+    // 在当前线程上等task结束,返回它的结果或者抛出它的异常
+    template<typename T>
+    T sync_wait(task<T> t) {
+        detail::sync_state<T> st;
+        detail::sync_wait_impl(t, st);
+        std::unique_lock<std::mutex> lock(st.m);
+        st.cv.wait(lock, [&] { return st.done; });
+        if (st.error)
+            std::rethrow_exception(st.error);
+        if constexpr (!std::is_void_v<T>)
+            return std::move(*st.value);
+    }
+
+    // 不等结果: task在当前线程上开始执行,直到第一次co_await pool.schedule()之类的挂起点; 抛出的异常会terminate
+    inline void spawn(task<void> t) {
+        detail::spawn_impl(std::move(t));
+    }
+
+    // 在pool的worker上执行f(),结果可以co_await
+    template<typename Pool, typename F>
+    auto run_on(Pool& pool, F f, priority pr = priority::normal) -> task<std::invoke_result_t<F&>> {
+        co_await pool.schedule(pr);
+        co_return f();
+    }
+
+}
@@ -0,0 +1,2748 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <variant>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#define JSON_SIMD_X86 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define JSON_SIMD_NEON 1
+#endif
+
+namespace json {
+    
+    // ---------------- Object的存储方式 ----------------
+    // 默认Object是std::map: 每个成员一次分配,查找要在树上跳指针; 定义JSON_FLAT_OBJECT后换成FlatObject,
+    // 成员按key排好序连续存放,查找是二分; 再定义JSON_INTERN_KEYS,key都放进全局的KeyPool,同样的key只存一份
+    // 三种方式遍历顺序都是按key排序,输出结果完全一样
+
+    class KeyPool {  // 所有文档共享的key池; 只增不减,适合key集合固定的场景(字段名),不要用来存任意的值
+    public:
+        static KeyPool& global() {
+            static KeyPool* pool = new KeyPool;  // 故意不释放,其他静态对象析构时可能还在用key
+            return *pool;
+        }
+        std::string_view intern(std::string_view key) {  // 返回的string_view一直有效
+            {
+                std::shared_lock<std::shared_mutex> lock(m);  // 大多数key都已经在池里,只需要读锁
+                auto it = keys.find(key);
+                if (it != keys.end())
+                    return *it;
+            }
+            std::unique_lock<std::shared_mutex> lock(m);
+            auto it = keys.find(key);
+            if (it != keys.end())
+                return *it;
+            std::string_view stored = storage.emplace_back(key);  // deque追加不会移动已有的元素
+            keys.insert(stored);
+            return stored;
+        }
+        size_t size() const {
+            std::shared_lock<std::shared_mutex> lock(m);
+            return keys.size();
+        }
+    private:
+        mutable std::shared_mutex m;
+        std::deque<std::string> storage;
+        std::unordered_set<std::string_view> keys;  // 指向storage里的字符串
+    };
+
+    class InternedKey {  // KeyPool里的一个key,只有一个string_view大小
+    public:
+        InternedKey(std::string_view key) : str(KeyPool::global().intern(key)) {}
+        InternedKey(const std::string& key) : InternedKey(std::string_view{ key }) {}
+        InternedKey(const char* key) : InternedKey(std::string_view{ key }) {}
+        operator std::string_view() const { return str; }
+        std::string_view view() const { return str; }
+        friend bool operator==(const InternedKey& a, const InternedKey& b) { return a.str.data() == b.str.data(); }  // 同一个池里内容相同就是同一个指针
+        friend bool operator<(const InternedKey& a, const InternedKey& b) { return a.str < b.str; }
+    private:
+        std::string_view str;
+    };
+
+    // 按key排序的连续数组,接口和std::map的常用部分一致; key可以是std::string或InternedKey
+    // 按顺序插入(key比现有的都大)是O(1)追加,否则要移动后面的元素,成员很多且乱序插入时不如std::map;
+    // 一次拿到全部成员时(解析器)用from_members,排序一次即可
+    // 和std::map不同: 插入新key(operator[], try_emplace, emplace)和erase可能移动元素,之前拿到的引用和迭代器全部失效,
+    // auto& a = obj["x"]; obj["a"] = 1; a = ...; 在FlatObject下是未定义行为
+    template<typename Key, typename T>
+    class FlatObject {
+    public:
+        using key_type = Key;
+        using mapped_type = T;
+        using value_type = std::pair<Key, T>;
+        using iterator = typename std::vector<value_type>::iterator;
+        using const_iterator = typename std::vector<value_type>::const_iterator;
+
+        iterator begin() { return items.begin(); }
+        iterator end() { return items.end(); }
+        const_iterator begin() const { return items.begin(); }
+        const_iterator end() const { return items.end(); }
+        size_t size() const { return items.size(); }
+        bool empty() const { return items.empty(); }
+        void clear() { items.clear(); }
+        void reserve(size_t n) { items.reserve(n); }
+
+        iterator find(std::string_view key) {
+            auto it = lower_bound(key);
+            return it != items.end() && std::string_view{ it->first } == key ? it : items.end();
+        }
+        const_iterator find(std::string_view key) const {
+            return const_cast<FlatObject*>(this)->find(key);
+        }
+        size_t count(std::string_view key) const { return find(key) != end() ? 1 : 0; }
+        T& at(std::string_view key) {
+            auto it = find(key);
+            if (it == items.end())
+                throw std::out_of_range("key not found");
+            return it->second;
+        }
+        const T& at(std::string_view key) const { return const_cast<FlatObject*>(this)->at(key); }
+
+        template<typename K, typename... Args>
+        std::pair<iterator, bool> try_emplace(K&& key, Args&&... args) {
+            std::string_view k{ key };
+            if (items.empty() || std::string_view{ items.back().first } < k) {  // 按顺序插入的快速路径
+                items.emplace_back(std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)), std::forward_as_tuple(std::forward<Args>(args)...));
+                return { items.end() - 1, true };
+            }
+            auto it = lower_bound(k);
+            if (it != items.end() && std::string_view{ it->first } == k)
+                return { it, false };
+            it = items.emplace(it, std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)), std::forward_as_tuple(std::forward<Args>(args)...));
+            return { it, true };
+        }
+        template<typename K, typename V>
+        std::pair<iterator, bool> insert_or_assign(K&& key, V&& value) {
+            auto res = try_emplace(std::forward<K>(key), std::forward<V>(value));
+            if (!res.second)
+                res.first->second = std::forward<V>(value);
+            return res;
+        }
+        template<typename K>
+        T& operator[](K&& key) { return try_emplace(std::forward<K>(key)).first->second; }
+        size_t erase(std::string_view key) {
+            auto it = find(key);
+            if (it == items.end())
+                return 0;
+            items.erase(it);
+            return 1;
+        }
+        iterator erase(const_iterator it) { return items.erase(it); }
+
+        friend bool operator==(const FlatObject& a, const FlatObject& b) { return a.items == b.items; }
+
+        // 接管一批按文档顺序排列的成员: 稳定排序一次,重复的key只留最后一个(和逐个operator[]赋值的结果一样)
+        static FlatObject from_members(std::vector<value_type>&& members) {
+            auto key_less = [](const value_type& a, const value_type& b) { return std::string_view{ a.first } < std::string_view{ b.first }; };
+            std::stable_sort(members.begin(), members.end(), key_less);
+            auto out = members.begin();
+            for (auto it = members.begin(); it != members.end(); ++it) {
+                auto next = it + 1;
+                if (next != members.end() && std::string_view{ next->first } == std::string_view{ it->first })
+                    continue;  // 后面还有同名的,这个被覆盖了
+                if (out != it)
+                    *out = std::move(*it);
+                ++out;
+            }
+            members.erase(out, members.end());
+            FlatObject object;
+            object.items = std::move(members);
+            return object;
+        }
+
+    private:
+        iterator lower_bound(std::string_view key) {
+            return std::lower_bound(items.begin(), items.end(), key, [](const value_type& item, std::string_view k) { return std::string_view{ item.first } < k; });
+        }
+        std::vector<value_type> items;
+    };
+
+    struct Node;
+    using Null = std::monostate;
+    using Bool = bool;
+    using Int = int64_t;
+    using Float = double;
+    using String = std::string;
+    using Array = std::vector<Node>;
+#if defined(JSON_FLAT_OBJECT) && defined(JSON_INTERN_KEYS)
+    using Object = FlatObject<InternedKey, Node>;
+#elif defined(JSON_FLAT_OBJECT)
+    using Object = FlatObject<std::string, Node>;
+#else
+    using Object = std::map<std::string, Node>;
+#endif
+    using Value = std::variant<Null, Bool, Int, Float, String, Array, Object>;
+    struct Node {
+        Value value;  // 可能是各种类型的值
+        Node(const Value& _value) : value(_value) {}
+        Node(Value&& _value) : value(std::move(_value)) {}  // 传右值(比如Node{ std::move(arr) })时整棵子树只移动,不复制
+        template<typename T, typename = std::enable_if_t<!std::is_same_v<std::decay_t<T>, Value> && std::is_constructible_v<Value, T&&>>>
+        Node(T&& _value) : value(std::forward<T>(_value)) {}  // Node{ Array{} }, Node{ 1.5 }: 直接构造value,不经过临时的Value
+        Node() : value(Null{}) {}
+        Node& operator[](const std::string& key) {  // Node1["abc"]
+            if (auto object = std::get_if<Object>(&value)) {
+                return  (*object)[key];
+            }
+            throw std::runtime_error("not an object");
+        }
+        Node& operator[](std::string&& key) {
+            if (auto object = std::get_if<Object>(&value)) {
+                return (*object)[std::move(key)];
+            }
+            throw std::runtime_error("not an object");
+        }
+        const Node& operator[](const std::string& key) const {  // const版本不插入,没有这个key就抛异常
+            if (auto object = std::get_if<Object>(&value)) {
+                auto it = object->find(key);
+                if (it == object->end()) {
+                    throw std::out_of_range("key not found");
+                }
+                return it->second;
+            }
+            throw std::runtime_error("not an object");
+        }
+        Node& operator[](size_t index) {  // Node2[2]; 返回引用,可以直接修改数组里的元素
+            if (auto array = std::get_if<Array>(&value)) {
+                return array->at(index);
+            }
+            throw std::runtime_error("not an array");
+        }
+        const Node& operator[](size_t index) const {
+            if (auto array = std::get_if<Array>(&value)) {
+                return array->at(index);
+            }
+            throw std::runtime_error("not an array");
+        }
+        void push(const Node& rhs) {  // Node3.push(Node4)
+            if (auto array = std::get_if<Array>(&value)) {
+                array->push_back(rhs);
+                return;
+            }
+            throw std::runtime_error("not an array push");
+        }
+        void push(Node&& rhs) {  // Node3.push(std::move(Node4))
+            if (auto array = std::get_if<Array>(&value)) {
+                array->push_back(std::move(rhs));
+                return;
+            }
+            throw std::runtime_error("not an array push");
+        }
+        template<typename... Args>
+        Node& emplace_back(Args&&... args) {  // 在数组末尾直接构造: arr.emplace_back(Object{}) 返回新元素
+            if (auto array = std::get_if<Array>(&value)) {
+                return array->emplace_back(std::forward<Args>(args)...);
+            }
+            throw std::runtime_error("not an array push");
+        }
+        template<typename K, typename... Args>
+        Node& emplace(K&& key, Args&&... args) {  // obj.emplace("k", 1); 已有这个key时覆盖
+            if (auto object = std::get_if<Object>(&value)) {
+                return object->insert_or_assign(std::forward<K>(key), Node{ std::forward<Args>(args)... }).first->second;
+            }
+            throw std::runtime_error("not an object");
+        }
+    };
+
+    // ---------------- stage 1: 结构字符索引 ----------------
+    // 类似simdjson的第一遍扫描: 每次处理64字节,用SIMD比较出引号/反斜杠/结构字符/空白的位掩码,
+    // 再用位运算算出哪些字节在字符串里,最后得到所有"token起点"的位置:
+    // {}[]:, 字符串的开头和结尾引号, 以及null/true/false/数字的第一个字节
+    // 递归下降的解析器靠这个索引直接跳过空白和字符串内容,不用逐字节判断
+
+    inline bool is_whitespace(char c) {  // JSON只有这四种空白; 不用std::isspace,它和locale有关而且慢
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+
+    enum class simd_level { scalar, sse2, avx2, neon };
+
+    struct block_masks {  // 64字节里各类字符的位置,第i位对应第i个字节
+        std::uint64_t quote = 0;
+        std::uint64_t backslash = 0;
+        std::uint64_t op = 0;  // {}[]:,
+        std::uint64_t space = 0;
+    };
+
+    inline block_masks classify_scalar(const char* p) {
+        block_masks m;
+        for (int i = 0; i < 64; i++) {
+            std::uint64_t bit = std::uint64_t(1) << i;
+            switch (p[i]) {
+                case '"': m.quote |= bit; break;
+                case '\\': m.backslash |= bit; break;
+                case '{': case '}': case '[': case ']': case ':': case ',': m.op |= bit; break;
+                case ' ': case '\t': case '\n': case '\r': m.space |= bit; break;
+                default: break;
+            }
+        }
+        return m;
+    }
+
+#if defined(JSON_SIMD_X86)
+    // x86-64上SSE2是基线指令集,不需要运行时检测; SSE4.2的pcmpistrm处理这种多字符匹配反而比cmpeq慢,所以没有用
+    inline block_masks classify_sse2(const char* p) {
+        block_masks m;
+        for (int k = 0; k < 4; k++) {
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * k));
+            auto eq = [&](char x) { return _mm_cmpeq_epi8(c, _mm_set1_epi8(x)); };
+            __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));  // '['|0x20 == '{', ']'|0x20 == '}'
+            __m128i op = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('{')), _mm_cmpeq_epi8(lower, _mm_set1_epi8('}'))),
+                _mm_or_si128(eq(':'), eq(',')));
+            __m128i space = _mm_or_si128(_mm_or_si128(eq(' '), eq('\t')), _mm_or_si128(eq('\n'), eq('\r')));
+            int shift = 16 * k;
+            m.quote |= std::uint64_t(std::uint16_t(_mm_movemask_epi8(eq('"')))) << shift;
+            m.backslash |= std::uint64_t(std::uint16_t(_mm_movemask_epi8(eq('\\')))) << shift;
+            m.op |= std::uint64_t(std::uint16_t(_mm_movemask_epi8(op))) << shift;
+            m.space |= std::uint64_t(std::uint16_t(_mm_movemask_epi8(space))) << shift;
+        }
+        return m;
+    }
+
+#if defined(__GNUC__)
+    __attribute__((target("avx2")))
+    inline block_masks classify_avx2(const char* p) {
+        block_masks m;
+        for (int k = 0; k < 2; k++) {
+            __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * k));
+            // 这里不能像SSE2版本那样用lambda: lambda不带target("avx2"),返回__m256i会触发-Wpsabi
+            __m256i lower = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+            __m256i op = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('}'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8(','))));
+            __m256i space = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\t'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\r'))));
+            __m256i quote = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('"'));
+            __m256i backslash = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\\'));
+            int shift = 32 * k;
+            m.quote |= std::uint64_t(std::uint32_t(_mm256_movemask_epi8(quote))) << shift;
+            m.backslash |= std::uint64_t(std::uint32_t(_mm256_movemask_epi8(backslash))) << shift;
+            m.op |= std::uint64_t(std::uint32_t(_mm256_movemask_epi8(op))) << shift;
+            m.space |= std::uint64_t(std::uint32_t(_mm256_movemask_epi8(space))) << shift;
+        }
+        return m;
+    }
+#endif
+#endif
+
+#if defined(JSON_SIMD_NEON)
+    inline std::uint64_t neon_movemask(uint8x16_t m0, uint8x16_t m1, uint8x16_t m2, uint8x16_t m3) {  // 4个16字节的比较结果压成64位掩码
+        const uint8x16_t weight = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80 };
+        uint8x16_t sum0 = vpaddq_u8(vandq_u8(m0, weight), vandq_u8(m1, weight));
+        uint8x16_t sum1 = vpaddq_u8(vandq_u8(m2, weight), vandq_u8(m3, weight));
+        sum0 = vpaddq_u8(sum0, sum1);
+        sum0 = vpaddq_u8(sum0, sum0);
+        return vgetq_lane_u64(vreinterpretq_u64_u8(sum0), 0);
+    }
+
+    inline block_masks classify_neon(const char* p) {
+        uint8x16_t quote[4], backslash[4], op[4], space[4];
+        for (int k = 0; k < 4; k++) {
+            uint8x16_t c = vld1q_u8(reinterpret_cast<const std::uint8_t*>(p + 16 * k));
+            auto eq = [&](char x) { return vceqq_u8(c, vdupq_n_u8(std::uint8_t(x))); };
+            uint8x16_t lower = vorrq_u8(c, vdupq_n_u8(0x20));
+            quote[k] = eq('"');
+            backslash[k] = eq('\\');
+            op[k] = vorrq_u8(vorrq_u8(vceqq_u8(lower, vdupq_n_u8('{')), vceqq_u8(lower, vdupq_n_u8('}'))), vorrq_u8(eq(':'), eq(',')));
+            space[k] = vorrq_u8(vorrq_u8(eq(' '), eq('\t')), vorrq_u8(eq('\n'), eq('\r')));
+        }
+        block_masks m;
+        m.quote = neon_movemask(quote[0], quote[1], quote[2], quote[3]);
+        m.backslash = neon_movemask(backslash[0], backslash[1], backslash[2], backslash[3]);
+        m.op = neon_movemask(op[0], op[1], op[2], op[3]);
+        m.space = neon_movemask(space[0], space[1], space[2], space[3]);
+        return m;
+    }
+#endif
+
+    inline simd_level best_simd_level() {  // 运行时选择当前CPU支持的最快实现
+#if defined(JSON_SIMD_X86)
+#if defined(__GNUC__)
+        static const bool has_avx2 = __builtin_cpu_supports("avx2");
+        if (has_avx2)
+            return simd_level::avx2;
+#endif
+        return simd_level::sse2;
+#elif defined(JSON_SIMD_NEON)
+        return simd_level::neon;
+#else
+        return simd_level::scalar;
+#endif
+    }
+
+    inline int count_trailing_zeros(std::uint64_t x) {
+#if defined(__GNUC__)
+        return __builtin_ctzll(x);
+#else
+        int n = 0;
+        while (!(x & 1)) {
+            x >>= 1;
+            n++;
+        }
+        return n;
+#endif
+    }
+
+    struct StructuralIndex {
+        std::unique_ptr<std::uint32_t[]> positions;  // 按顺序排列的token起点
+        size_t count = 0;
+        size_t capacity = 0;  // positions的大小; 同一个StructuralIndex重复使用时,输入不比它长就不用重新分配
+        bool unclosed_string = false;  // 扫描结束时还在字符串里
+    };
+
+    // 把json_str的索引建在index里; 输入超过4GB时位置存不进uint32_t,返回false,调用者退回逐字节扫描
+    inline bool build_structural_index(std::string_view json_str, StructuralIndex& index, simd_level level = best_simd_level()) {
+        if (json_str.size() >= UINT32_MAX) {
+            return false;
+        }
+        auto classify = [level](const char* p) {
+            switch (level) {
+#if defined(JSON_SIMD_X86)
+                case simd_level::sse2:
+                    return classify_sse2(p);
+#if defined(__GNUC__)
+                case simd_level::avx2:
+                    return classify_avx2(p);
+#endif
+#endif
+#if defined(JSON_SIMD_NEON)
+                case simd_level::neon:
+                    return classify_neon(p);
+#endif
+                default:
+                    return classify_scalar(p);
+            }
+        };
+        // 最多每个字节一个token起点; 不用vector是为了不把整块内存清零,没用到的页不会占物理内存
+        if (index.capacity < json_str.size() + 1) {
+            index.positions.reset(new std::uint32_t[json_str.size() + 1]);
+            index.capacity = json_str.size() + 1;
+        }
+        std::uint32_t* out = index.positions.get();
+        std::uint64_t prev_escaped = 0;  // 上一块最后一个字节是没被转义的反斜杠,本块第0个字节被转义
+        std::uint64_t prev_in_string = 0;  // 上一块结束时还在字符串里: 全1,否则全0
+        std::uint64_t prev_scalar = 0;  // 上一块最后一个字节是null/true/数字等的一部分
+        char tail[64];
+        for (size_t base = 0; base < json_str.size(); base += 64) {
+            const char* p = json_str.data() + base;
+            if (json_str.size() - base < 64) {  // 最后不满64字节的一块用空格补齐
+                std::memset(tail, ' ', sizeof(tail));  // 空格不会产生token起点
+                std::memcpy(tail, p, json_str.size() - base);
+                p = tail;
+            }
+            block_masks m = classify(p);
+
+            // 被转义的字符: 从前往后看每个反斜杠,没被转义的反斜杠会转义它后一个字节; 反斜杠很少,逐个处理就够了
+            std::uint64_t escaped = prev_escaped;
+            prev_escaped = 0;
+            for (std::uint64_t bs = m.backslash; bs != 0; bs &= bs - 1) {
+                int i = count_trailing_zeros(bs);
+                if (escaped & (std::uint64_t(1) << i))
+                    continue;
+                if (i == 63)
+                    prev_escaped = 1;
+                else
+                    escaped |= std::uint64_t(1) << (i + 1);
+            }
+            std::uint64_t quote = m.quote & ~escaped;
+
+            // 前缀异或: 第i位 = 第0..i位里引号个数的奇偶,也就是这个字节是否在字符串里(包括开头引号,不包括结尾引号)
+            std::uint64_t in_string = quote;
+            in_string ^= in_string << 1;
+            in_string ^= in_string << 2;
+            in_string ^= in_string << 4;
+            in_string ^= in_string << 8;
+            in_string ^= in_string << 16;
+            in_string ^= in_string << 32;
+            in_string ^= prev_in_string;
+            prev_in_string = std::uint64_t(0) - (in_string >> 63);
+
+            // 字符串外面既不是结构字符也不是空白的,就是标量(null/true/false/数字)的字节,只有第一个字节算token起点
+            std::uint64_t scalar = ~(m.op | m.space | quote) & ~in_string;
+            std::uint64_t scalar_start = scalar & ~((scalar << 1) | prev_scalar);
+            prev_scalar = scalar >> 63;
+
+            std::uint64_t structural = (m.op & ~in_string) | quote | scalar_start;
+            for (; structural != 0; structural &= structural - 1)
+                *out++ = std::uint32_t(base + count_trailing_zeros(structural));
+        }
+        index.count = size_t(out - index.positions.get());
+        index.unclosed_string = prev_in_string != 0;
+        return true;
+    }
+
+    inline std::unique_ptr<StructuralIndex> build_structural_index(std::string_view json_str, simd_level level = best_simd_level()) {
+        auto index = std::make_unique<StructuralIndex>();
+        if (!build_structural_index(json_str, *index, level)) {
+            return nullptr;
+        }
+        return index;
+    }
+
+    // ---------------- 事件(SAX)接口 ----------------
+    // JsonParser和PushParser都可以把解析结果以事件的形式交给一个Handler,而不是构造Node;
+    // 只需要少数几个字段的过滤/统计任务可以边解析边处理,内存占用和文档大小无关
+    // Handler需要提供下面这些函数,返回false表示中止解析:
+    //     bool on_null(); bool on_bool(Bool); bool on_int(Int); bool on_float(Float);
+    //     bool on_string(std::string_view); bool on_key(std::string_view);
+    //     bool start_object(); bool end_object(); bool start_array(); bool end_array();
+    // 传给on_string/on_key的string_view只在这次调用期间有效
+    // DOM(Node)也只是其中一种Handler: DomBuilder
+
+    struct DomBuilder {  // 把事件组装成Node的Handler
+        std::vector<Node> stack;  // 正在构造的容器
+        std::vector<std::string> keys;  // 每一层对象里等待值的key
+        std::optional<Node> result;
+#if defined(JSON_FLAT_OBJECT)
+        // FlatObject乱序逐个插入是O(n^2): 各层对象的成员先按文档顺序攒在这里,对象结束时from_members排序一次
+        std::vector<Object::value_type> members;
+        std::vector<size_t> member_base;  // 每一层对象的成员在members里的起点
+#endif
+
+        bool add(Node node) {
+            if (stack.empty()) {
+                result = std::move(node);
+            }
+            else if (auto array = std::get_if<Array>(&stack.back().value)) {
+                array->push_back(std::move(node));
+            }
+            else {
+#if defined(JSON_FLAT_OBJECT)
+                members.emplace_back(std::move(keys.back()), std::move(node));
+#else
+                std::get<Object>(stack.back().value)[std::move(keys.back())] = std::move(node);
+#endif
+                keys.pop_back();
+            }
+            return true;
+        }
+        bool on_null() { return add(Node{}); }
+        bool on_bool(Bool v) { return add(Node{ v }); }
+        bool on_int(Int v) { return add(Node{ v }); }
+        bool on_float(Float v) { return add(Node{ v }); }
+        bool on_string(std::string_view v) { return add(Node{ String{ v } }); }
+        bool on_key(std::string_view key) {
+            keys.emplace_back(key);
+            return true;
+        }
+        bool start_object() {
+            stack.emplace_back(Object{});
+#if defined(JSON_FLAT_OBJECT)
+            member_base.push_back(members.size());
+#endif
+            return true;
+        }
+        bool start_array() {
+            stack.emplace_back(Array{});
+            return true;
+        }
+        bool end_object() {
+#if defined(JSON_FLAT_OBJECT)
+            auto first = members.begin() + std::ptrdiff_t(member_base.back());
+            member_base.pop_back();
+            std::get<Object>(stack.back().value) = Object::from_members(std::vector<Object::value_type>(std::make_move_iterator(first), std::make_move_iterator(members.end())));
+            members.erase(first, members.end());
+#endif
+            return end_container();
+        }
+        bool end_array() { return end_container(); }
+        bool end_container() {
+            Node node = std::move(stack.back());
+            stack.pop_back();
+            return add(std::move(node));
+        }
+    };
+
+    struct JsonParser {
+        std::string_view json_str;
+        size_t pos = 0;
+        const StructuralIndex* index = nullptr;  // 非空时跳空白,找字符串结尾都直接查索引
+        size_t cursor = 0;  // index里第一个 >= pos 的位置(大致,用到时再往前推)
+        std::string scratch{};  // 解码带转义的字符串用
+
+        void parse_whitespace() {
+            if (index != nullptr) {
+                // 当前字节是空白时,下一个token起点之前全是空白,直接跳过去
+                if (pos >= json_str.size() || !is_whitespace(json_str[pos])) {
+                    return;
+                }
+                while (cursor < index->count && index->positions[cursor] < pos) {
+                    cursor++;
+                }
+                pos = cursor < index->count ? index->positions[cursor] : json_str.size();
+                return;
+            }
+            while (pos < json_str.size() && is_whitespace(json_str[pos])) {
+                ++pos;
+            }
+        }
+
+        // pos指向开头的'"',返回结尾'"'的位置,escaped表示中间有没有反斜杠; 没有结尾的引号返回npos
+        size_t string_end(bool& escaped) {
+            if (index != nullptr) {
+                while (cursor < index->count && index->positions[cursor] <= pos) {
+                    cursor++;
+                }
+                if (cursor == index->count || json_str[index->positions[cursor]] != '"') {
+                    return std::string_view::npos;
+                }
+                size_t end = index->positions[cursor];
+                escaped = std::memchr(json_str.data() + pos + 1, '\\', end - pos - 1) != nullptr;
+                return end;
+            }
+            return find_string_end(json_str, pos + 1, escaped);
+        }
+
+        auto parse_null() -> std::optional<Value> {
+            if (json_str.substr(pos, 4) == "null") {
+                pos += 4;
+                return Null{};
+            }
+            return{};
+        }
+
+        auto parse_true() -> std::optional<Value> {
+            if (json_str.substr(pos, 4) == "true") {
+                pos += 4;
+                return true;
+            }
+            return {};
+        }
+
+        auto parse_false() -> std::optional<Value> {
+            if (json_str.substr(pos, 5) == "false") {
+                pos += 5;
+                return false;
+            }
+            return {};
+        }
+
+        static bool is_digit(char c) {
+            return c >= '0' && c <= '9';
+        }
+
+        // 转换[begin, end)里已经检查过格式的小数; 超出double范围时和strtod一样返回(带符号的)0或无穷大
+        static Float to_float(const char* begin, const char* end) {
+            Float value = 0;
+#if defined(__cpp_lib_to_chars)
+            auto [ptr, ec] = std::from_chars(begin, end, value);  // libstdc++从GCC 12开始内部用的是fast_float(Eisel-Lemire)
+            if (ec != std::errc::result_out_of_range) {
+                (void)ptr;
+                return value;
+            }
+            // 超出范围(有的实现连非规格化数也算)时from_chars不写value: 交给strtod,它按实际的数量级舍入成非规格化数、带符号的0或无穷大
+#endif
+            std::string number{ begin, end };  // strtod需要'\0'结尾
+            value = std::strtod(number.c_str(), nullptr);
+            return value;
+        }
+
+        // -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+        // 没有小数点和指数并且放得下int64_t的是Int,其余(包括溢出int64_t的整数)都是Float; 不抛异常,格式不对返回nullopt
+        auto parse_number()->std::optional<Value> {
+            const char* begin = json_str.data() + pos;
+            const char* end = json_str.data() + json_str.size();
+            const char* p = begin;
+            bool negative = p != end && *p == '-';
+            if (negative) {
+                p++;
+            }
+            const char* digits = p;
+            std::uint64_t mantissa = 0;
+            while (p != end && is_digit(*p)) {
+                mantissa = mantissa * 10 + std::uint64_t(*p - '0');  // 超过19位会溢出,下面按位数判断,不用这个值
+                p++;
+            }
+            size_t num_digits = size_t(p - digits);
+            if (num_digits == 0 || (num_digits > 1 && *digits == '0')) {  // 没有数字,或者有多余的前导0
+                return {};
+            }
+            bool is_float = false;
+            if (p != end && *p == '.') {
+                const char* frac = ++p;
+                while (p != end && is_digit(*p)) {
+                    p++;
+                }
+                if (p == frac) {
+                    return {};
+                }
+                is_float = true;
+            }
+            if (p != end && (*p == 'e' || *p == 'E')) {
+                p++;
+                if (p != end && (*p == '+' || *p == '-')) {
+                    p++;
+                }
+                const char* exp = p;
+                while (p != end && is_digit(*p)) {
+                    p++;
+                }
+                if (p == exp) {
+                    return {};
+                }
+                is_float = true;
+            }
+            pos = size_t(p - json_str.data());
+            if (!is_float && num_digits <= 19) {  // 19位十进制数一定放得下uint64_t
+                constexpr auto max = std::uint64_t(std::numeric_limits<Int>::max());
+                if (!negative && mantissa <= max) {
+                    return Int(mantissa);
+                }
+                if (negative && mantissa <= max + 1) {
+                    return Int(~mantissa + 1);  // -mantissa,不经过有符号溢出
+                }
+            }
+            return to_float(begin, p);
+        }
+
+        // 从from(开头的'"'之后)开始找结束的'"',跳过转义字符; 没有结束的引号返回npos
+        static size_t find_string_end(std::string_view str, size_t from, bool& escaped) {
+            for (size_t i = from; i < str.size(); i++) {
+                if (str[i] == '"') {
+                    return i;
+                }
+                if (str[i] == '\\') {
+                    escaped = true;
+                    i++;  // 跳过被转义的字符,比如 \"
+                }
+            }
+            return std::string_view::npos;
+        }
+
+        static int parse_hex4(std::string_view str, size_t from) {  // \uXXXX里的XXXX,不合法返回-1
+            if (from + 4 > str.size()) {
+                return -1;
+            }
+            int code = 0;
+            for (size_t i = from; i < from + 4; i++) {
+                char c = str[i];
+                int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+                if (digit < 0) {
+                    return -1;
+                }
+                code = code * 16 + digit;
+            }
+            return code;
+        }
+
+        // 把去掉引号的原始内容解码到out,返回解码后的长度; 解码结果不会比原文长,所以out准备raw.size()字节就够
+        // 转义不合法返回npos
+        static size_t unescape(std::string_view raw, char* out) {
+            size_t len = 0;
+            for (size_t i = 0; i < raw.size(); i++) {
+                if (raw[i] != '\\') {
+                    out[len++] = raw[i];
+                    continue;
+                }
+                if (++i >= raw.size()) {
+                    return std::string_view::npos;
+                }
+                switch (raw[i]) {
+                    case '"': out[len++] = '"'; break;
+                    case '\\': out[len++] = '\\'; break;
+                    case '/': out[len++] = '/'; break;
+                    case 'b': out[len++] = '\b'; break;
+                    case 'f': out[len++] = '\f'; break;
+                    case 'n': out[len++] = '\n'; break;
+                    case 'r': out[len++] = '\r'; break;
+                    case 't': out[len++] = '\t'; break;
+                    case 'u': {
+                        long code = parse_hex4(raw, i + 1);
+                        if (code < 0) {
+                            return std::string_view::npos;
+                        }
+                        i += 4;
+                        if (code >= 0xD800 && code <= 0xDBFF) {  // 高代理,后面必须跟一个\u低代理
+                            if (i + 2 >= raw.size() || raw[i + 1] != '\\' || raw[i + 2] != 'u') {
+                                return std::string_view::npos;
+                            }
+                            long low = parse_hex4(raw, i + 3);
+                            if (low < 0xDC00 || low > 0xDFFF) {
+                                return std::string_view::npos;
+                            }
+                            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                            i += 6;
+                        }
+                        else if (code >= 0xDC00 && code <= 0xDFFF) {  // 单独的低代理
+                            return std::string_view::npos;
+                        }
+                        if (code < 0x80) {  // 编码成UTF-8
+                            out[len++] = char(code);
+                        }
+                        else if (code < 0x800) {
+                            out[len++] = char(0xC0 | (code >> 6));
+                            out[len++] = char(0x80 | (code & 0x3F));
+                        }
+                        else if (code < 0x10000) {
+                            out[len++] = char(0xE0 | (code >> 12));
+                            out[len++] = char(0x80 | ((code >> 6) & 0x3F));
+                            out[len++] = char(0x80 | (code & 0x3F));
+                        }
+                        else {
+                            out[len++] = char(0xF0 | (code >> 18));
+                            out[len++] = char(0x80 | ((code >> 12) & 0x3F));
+                            out[len++] = char(0x80 | ((code >> 6) & 0x3F));
+                            out[len++] = char(0x80 | (code & 0x3F));
+                        }
+                        break;
+                    }
+                    default:
+                        return std::string_view::npos;
+                }
+            }
+            return len;
+        }
+
+        // pos指向开头的'"'; 不带转义时直接返回输入里的一段,带转义时解码进scratch(下一次调用会覆盖)
+        auto parse_string_raw() -> std::optional<std::string_view> {
+            bool escaped = false;
+            size_t endpos = string_end(escaped);
+            if (endpos == std::string_view::npos) {
+                return {};
+            }
+            std::string_view raw = json_str.substr(pos + 1, endpos - pos - 1);
+            pos = endpos + 1;  // "
+            if (!escaped) {
+                return raw;
+            }
+            scratch.resize(raw.size());
+            size_t len = unescape(raw, scratch.data());
+            if (len == std::string_view::npos) {
+                return {};
+            }
+            return std::string_view{ scratch.data(), len };
+        }
+
+        auto parse_string() -> std::optional<Value> {
+            auto str = parse_string_raw();
+            if (!str) {
+                return {};
+            }
+            return std::string{ *str };
+        }
+
+        // 从pos开始解析一个值,把它以事件的形式交给handler; 语法和parse_value一样宽松
+        template<typename Handler>
+        bool parse_events(Handler& handler) {
+            parse_whitespace();
+            if (pos >= json_str.size()) {
+                return false;
+            }
+            switch (json_str[pos]) {
+                case '"': {
+                    auto str = parse_string_raw();
+                    return str && handler.on_string(*str);
+                }
+                case '[': {
+                    pos++;  // [
+                    parse_whitespace();  // 空容器 [ ] / { } 里也可能有空白
+                    if (!handler.start_array()) {
+                        return false;
+                    }
+                    while (pos < json_str.size() && json_str[pos] != ']') {
+                        if (!parse_events(handler)) {
+                            return false;
+                        }
+                        parse_whitespace();
+                        if (pos < json_str.size() && json_str[pos] == ',') {
+                            pos++;  // ,
+                        }
+                        parse_whitespace();
+                    }
+                    if (pos >= json_str.size()) {
+                        return false;  // 没有结束的']'
+                    }
+                    pos++;  // ]
+                    return handler.end_array();
+                }
+                case '{': {
+                    pos++;  // {
+                    parse_whitespace();
+                    if (!handler.start_object()) {
+                        return false;
+                    }
+                    while (pos < json_str.size() && json_str[pos] != '}') {
+                        if (json_str[pos] != '"') {  // key如果不是string类型的,那就结束(出错)
+                            return false;
+                        }
+                        auto key = parse_string_raw();
+                        if (!key || !handler.on_key(*key)) {
+                            return false;
+                        }
+                        parse_whitespace();
+                        if (pos < json_str.size() && json_str[pos] == ':') {
+                            pos++;  // :
+                        }
+                        if (!parse_events(handler)) {  // 递归
+                            return false;
+                        }
+                        parse_whitespace();
+                        if (pos < json_str.size() && json_str[pos] == ',') {
+                            pos++;  // ,
+                        }
+                        parse_whitespace();
+                    }
+                    if (pos >= json_str.size()) {
+                        return false;  // 没有结束的'}'
+                    }
+                    pos++;  // }
+                    return handler.end_object();
+                }
+                default: {
+                    auto value = parse_value();  // null/true/false/数字
+                    if (!value) {
+                        return false;
+                    }
+                    if (auto v = std::get_if<Bool>(&*value))
+                        return handler.on_bool(*v);
+                    if (auto v = std::get_if<Int>(&*value))
+                        return handler.on_int(*v);
+                    if (auto v = std::get_if<Float>(&*value))
+                        return handler.on_float(*v);
+                    return handler.on_null();
+                }
+            }
+        }
+
+        auto build_dom() -> std::optional<Value> {  // 把pos处的值交给DomBuilder构造
+            DomBuilder builder;
+            if (!parse_events(builder)) {
+                return {};
+            }
+            return std::move(builder.result->value);
+        }
+
+        auto parse_array() -> std::optional<Value> {
+            return build_dom();
+        }
+
+        std::optional<Value> parse_object() {
+            return build_dom();
+        }
+
+        std::optional<Value> parse_value() {
+            parse_whitespace();
+            if (pos >= json_str.size()) {
+                return {};
+            }
+            switch (json_str[pos]) {
+                case 'n':
+                    return parse_null();
+                case 't':
+                    return parse_true();  // 返回一个bool的true,或者{}
+                case 'f':
+                    return parse_false();
+                case '"':
+                    return parse_string();
+                case '[':
+                    return parse_array();
+                case '{':
+                    return parse_object();
+                default:
+                    return parse_number();
+            }
+        }
+
+        std::optional<Node> parse() {
+            parse_whitespace();
+            auto value = parse_value();
+            if (!value) {
+                return {};  // 如果parse_value()返回一个nullopt,说明解析失败,
+            }
+            return std::optional<Node>{ std::in_place, std::move(*value) };
+        }
+    };
+
+
+    // {"config": "yaml", "lr": [0.5, 0.6], "dropout": true}
+    // 输入json文件中的字符串,用这个字符串来构造一个JsonParser对象
+    inline std::optional<Node> parser(std::string_view json_str) {
+        auto index = build_structural_index(json_str);
+        JsonParser p{json_str, 0, index.get()};
+        return p.parse();
+    }
+
+
+    // ---------------- arena DOM ----------------
+    // Node的每个String/Array/Object都各自在堆上分配,大文档解析下来是几百万次小分配,指针散落在整个堆上
+    // Document把所有节点,字符串和容器都放在一个Arena里: 对象存成扁平的key/value数组,整棵树的释放只是释放Arena的几个大块
+
+    class Arena {  // 单调(bump)分配器: 从大块内存里顺序切,不支持单独释放,只能整体释放或者reset
+    public:
+        explicit Arena(size_t first_block = 64 * 1024) : next_size(std::max<size_t>(first_block, 256)) {}
+        Arena(Arena&& rhs) noexcept : blocks(std::move(rhs.blocks)), cur(std::exchange(rhs.cur, nullptr)), end(std::exchange(rhs.end, nullptr)),
+            next_size(rhs.next_size), block_size(std::exchange(rhs.block_size, 0)), used(std::exchange(rhs.used, 0)), reserved(std::exchange(rhs.reserved, 0)) {}
+        Arena& operator=(Arena&& rhs) noexcept {
+            if (this != &rhs) {
+                blocks = std::move(rhs.blocks);
+                cur = std::exchange(rhs.cur, nullptr);
+                end = std::exchange(rhs.end, nullptr);
+                next_size = rhs.next_size;
+                block_size = std::exchange(rhs.block_size, 0);
+                used = std::exchange(rhs.used, 0);
+                reserved = std::exchange(rhs.reserved, 0);
+            }
+            return *this;
+        }
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        void* allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+            char* p = align_up(cur, align);
+            if (cur == nullptr || p > end || size > size_t(end - p)) {  // 对齐之后可能已经越过了块的末尾
+                grow(size + align);
+                p = align_up(cur, align);
+            }
+            cur = p + size;
+            used += size;
+            return p;
+        }
+
+        template<typename T>
+        T* copy(const T* src, size_t n) {  // 把n个元素复制进arena; 只允许平凡类型,这样arena释放时不需要调用析构函数
+            static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>);
+            if (n == 0)
+                return nullptr;
+            T* dst = static_cast<T*>(allocate(sizeof(T) * n, alignof(T)));
+            std::memcpy(static_cast<void*>(dst), src, sizeof(T) * n);
+            return dst;
+        }
+
+        std::string_view copy_string(std::string_view str) {
+            if (str.empty())
+                return {};
+            char* dst = static_cast<char*>(allocate(str.size(), 1));
+            std::memcpy(dst, str.data(), str.size());
+            return { dst, str.size() };
+        }
+
+        void reset() {  // 只保留最后(最大)的一块,其余还给系统; 之前分配出去的指针全部失效
+            if (blocks.size() > 1) {
+                blocks.erase(blocks.begin(), blocks.end() - 1);
+                reserved = block_size;
+            }
+            cur = blocks.empty() ? nullptr : blocks.back().get();
+            end = cur == nullptr ? nullptr : cur + block_size;
+            used = 0;
+        }
+
+        void adopt(Arena&& other) {  // 接管other的所有块: 之前从other分配的指针继续有效,之后和这个arena一起释放
+            if (other.blocks.empty() || &other == this)
+                return;
+            if (blocks.empty()) {
+                block_size = other.block_size;
+                blocks = std::move(other.blocks);
+            }
+            else {  // 插在当前块前面,最后一块还是正在分配的那块
+                blocks.insert(blocks.end() - 1, std::make_move_iterator(other.blocks.begin()), std::make_move_iterator(other.blocks.end()));
+            }
+            used += other.used;
+            reserved += other.reserved;
+            other.blocks.clear();
+            other.cur = other.end = nullptr;
+            other.block_size = other.used = other.reserved = 0;
+        }
+
+        size_t bytes_used() const { return used; }
+        size_t bytes_reserved() const { return reserved; }
+
+    private:
+        static char* align_up(char* p, size_t align) {
+            auto addr = reinterpret_cast<std::uintptr_t>(p);
+            return p + ((align - addr % align) % align);
+        }
+        void grow(size_t min_size) {
+            block_size = std::max(next_size, min_size);
+            blocks.emplace_back(new char[block_size]);  // 不用make_unique,避免把整块内存清零
+            cur = blocks.back().get();
+            end = cur + block_size;
+            reserved += block_size;
+            next_size = std::min<size_t>(block_size * 2, size_t(64) << 20);  // 每次翻倍,最大64MB一块
+        }
+
+        std::vector<std::unique_ptr<char[]>> blocks;
+        char* cur = nullptr;
+        char* end = nullptr;
+        size_t next_size;
+        size_t block_size = 0;  // 最后一块的大小
+        size_t used = 0;
+        size_t reserved = 0;
+    };
+
+    enum class Type : std::uint8_t { Null, Bool, Int, Float, String, Array, Object };
+
+    struct ArenaMember;
+
+    template<typename T>
+    struct range {  // 一段连续的只读元素,用来遍历ArenaNode的数组元素和对象成员
+        const T* first = nullptr;
+        const T* last = nullptr;
+        const T* begin() const { return first; }
+        const T* end() const { return last; }
+        size_t size() const { return size_t(last - first); }
+        bool empty() const { return first == last; }
+    };
+
+    // 16字节的只读节点,字符串/数组/对象都指向arena里的内存,本身平凡可复制,不需要析构
+    struct ArenaNode {
+        Type tag = Type::Null;
+        std::uint32_t len = 0;  // String的字节数, Array的元素个数, Object的成员个数
+        union {
+            Bool b;
+            Int i = 0;
+            Float f;
+            const char* str;
+            const ArenaNode* items;
+            const ArenaMember* members;
+        };
+
+        static ArenaNode make_bool(Bool v) { ArenaNode n; n.tag = Type::Bool; n.b = v; return n; }
+        static ArenaNode make_int(Int v) { ArenaNode n; n.tag = Type::Int; n.i = v; return n; }
+        static ArenaNode make_float(Float v) { ArenaNode n; n.tag = Type::Float; n.f = v; return n; }
+        static ArenaNode make_string(std::string_view v) { ArenaNode n; n.tag = Type::String; n.str = v.data(); n.len = std::uint32_t(v.size()); return n; }
+        static ArenaNode make_array(const ArenaNode* v, size_t size) { ArenaNode n; n.tag = Type::Array; n.items = v; n.len = std::uint32_t(size); return n; }
+        static ArenaNode make_object(const ArenaMember* v, size_t size) { ArenaNode n; n.tag = Type::Object; n.members = v; n.len = std::uint32_t(size); return n; }
+
+        Type type() const { return tag; }
+        bool is_null() const { return tag == Type::Null; }
+        Bool as_bool() const {
+            if (tag != Type::Bool)
+                throw std::runtime_error("not a bool");
+            return b;
+        }
+        Int as_int() const {
+            if (tag != Type::Int)
+                throw std::runtime_error("not an int");
+            return i;
+        }
+        Float as_float() const {  // Int也可以当Float读
+            if (tag == Type::Int)
+                return Float(i);
+            if (tag != Type::Float)
+                throw std::runtime_error("not a float");
+            return f;
+        }
+        std::string_view as_string() const {
+            if (tag != Type::String)
+                throw std::runtime_error("not a string");
+            return { str, len };
+        }
+        size_t size() const { return tag == Type::Array || tag == Type::Object ? len : 0; }
+        range<ArenaNode> elements() const {
+            if (tag != Type::Array)
+                throw std::runtime_error("not an array");
+            return { items, items + len };
+        }
+        inline range<ArenaMember> fields() const;
+        const ArenaNode& operator[](size_t index) const {  // doc.root[2]
+            if (tag != Type::Array)
+                throw std::runtime_error("not an array");
+            if (index >= len)
+                throw std::out_of_range("array index out of range");
+            return items[index];
+        }
+        inline const ArenaNode* find(std::string_view key) const;  // 找不到返回nullptr
+        const ArenaNode& operator[](std::string_view key) const {  // doc.root["abc"]; 只读,找不到就抛异常
+            if (auto node = find(key))
+                return *node;
+            throw std::out_of_range("key not found");
+        }
+        inline Node to_node() const;  // 转换成普通的Node,之后可以修改
+    };
+
+    struct ArenaMember {
+        std::string_view key;
+        ArenaNode value;
+    };
+
+    inline range<ArenaMember> ArenaNode::fields() const {
+        if (tag != Type::Object)
+            throw std::runtime_error("not an object");
+        return { members, members + len };
+    }
+
+    inline const ArenaNode* ArenaNode::find(std::string_view key) const {
+        if (tag != Type::Object)
+            throw std::runtime_error("not an object");
+        for (size_t k = len; k-- > 0; ) {  // 重复的key在解析时已经只留下最后一个(见ArenaParser::drop_shadowed_members)
+            if (members[k].key == key)
+                return &members[k].value;
+        }
+        return nullptr;
+    }
+
+    inline Node ArenaNode::to_node() const {
+        switch (tag) {
+            case Type::Null:
+                return Node{};
+            case Type::Bool:
+                return Node{ b };
+            case Type::Int:
+                return Node{ i };
+            case Type::Float:
+                return Node{ f };
+            case Type::String:
+                return Node{ String{ str, len } };
+            case Type::Array: {
+                Array arr;
+                arr.reserve(len);
+                for (auto& item : elements())
+                    arr.push_back(item.to_node());
+                return Node{ std::move(arr) };
+            }
+            case Type::Object: {
+#if defined(JSON_FLAT_OBJECT)
+                std::vector<Object::value_type> members;  // fields()是文档顺序,一次排好序再交给FlatObject
+                members.reserve(len);
+                for (auto& [key, value] : fields())
+                    members.emplace_back(std::string{ key }, value.to_node());
+                return Node{ Object::from_members(std::move(members)) };
+#else
+                Object obj;
+                for (auto& [key, value] : fields())
+                    obj[std::string{ key }] = value.to_node();
+                return Node{ std::move(obj) };
+#endif
+            }
+        }
+        return Node{};
+    }
+
+    struct Document {  // 一次解析的结果: root以及它引用的所有内存都在arena里,Document析构(或arena.reset())就整体释放
+        Arena arena;
+        ArenaNode root;
+        std::shared_ptr<const void> source{};  // zero_copy时字符串引用的输入(比如parse_document_file映射的文件),和Document一起释放
+    };
+
+    // 复用JsonParser的空白/字面量/数字解析,只把字符串和容器换成写进arena的版本
+    struct ArenaParser : JsonParser {
+        Arena& arena;
+        std::vector<ArenaNode> item_stack;  // 正在解析的各层数组的元素,解析完一层就整体复制进arena再弹出
+        std::vector<ArenaMember> member_stack;  // 同上,对象成员
+        std::unordered_set<std::string_view> seen_keys;  // drop_shadowed_members处理大对象时复用
+        bool zero_copy = false;  // 见parse_options::zero_copy
+
+        ArenaParser(std::string_view _json_str, Arena& _arena, bool _zero_copy = false) : JsonParser{ _json_str }, arena(_arena), zero_copy(_zero_copy) {}
+
+        // 不带转义的字符串: zero_copy时直接指向输入,否则复制进arena; 带转义的解码进arena
+        auto parse_string_view() -> std::optional<std::string_view> {
+            bool escaped = false;
+            size_t endpos = string_end(escaped);
+            if (endpos == std::string_view::npos) {
+                return {};  // 没有结束的引号
+            }
+            std::string_view raw = json_str.substr(pos + 1, endpos - pos - 1);
+            pos = endpos + 1;  // "
+            if (!escaped) {
+                return zero_copy ? raw : arena.copy_string(raw);
+            }
+            char* out = static_cast<char*>(arena.allocate(raw.size(), 1));
+            size_t len = unescape(raw, out);
+            if (len == std::string_view::npos) {
+                return {};
+            }
+            return std::string_view{ out, len };
+        }
+
+        auto parse_array_node() -> std::optional<ArenaNode> {
+            pos++;  // [
+            parse_whitespace();
+            size_t base = item_stack.size();
+            while (pos < json_str.size() && json_str[pos] != ']') {
+                auto value = parse_node();
+                if (!value) {
+                    return {};
+                }
+                item_stack.push_back(*value);
+                parse_whitespace();
+                if (pos < json_str.size() && json_str[pos] == ',') {
+                    pos++;  // ,
+                }
+                parse_whitespace();
+            }
+            if (pos >= json_str.size()) {
+                return {};  // 没有结束的']'
+            }
+            pos++;  // ]
+            size_t count = item_stack.size() - base;
+            auto node = ArenaNode::make_array(arena.copy(item_stack.data() + base, count), count);
+            item_stack.resize(base);
+            return node;
+        }
+
+        auto parse_object_node() -> std::optional<ArenaNode> {
+            pos++;  // {
+            parse_whitespace();
+            size_t base = member_stack.size();
+            while (pos < json_str.size() && json_str[pos] != '}') {
+                parse_whitespace();
+                if (pos >= json_str.size() || json_str[pos] != '"') {  // key如果不是string类型的,那就结束(出错)
+                    return {};
+                }
+                auto key = parse_string_view();
+                if (!key) {
+                    return {};
+                }
+                parse_whitespace();
+                if (pos < json_str.size() && json_str[pos] == ':') {
+                    pos++;  // :
+                }
+                parse_whitespace();
+                auto val = parse_node();  // 递归
+                if (!val) {
+                    return {};
+                }
+                member_stack.push_back({ *key, *val });
+                parse_whitespace();
+                if (pos < json_str.size() && json_str[pos] == ',') {
+                    pos++;  // ,
+                }
+                parse_whitespace();
+            }
+            if (pos >= json_str.size()) {
+                return {};  // 没有结束的'}'
+            }
+            pos++;  // }
+            drop_shadowed_members(base);
+            size_t count = member_stack.size() - base;
+            auto node = ArenaNode::make_object(arena.copy(member_stack.data() + base, count), count);
+            member_stack.resize(base);
+            return node;
+        }
+
+        // 重复的key只留最后一个,和Object(std::map)一样: fields()/write()/to_node()看到的对象和Node的一致
+        // 没有重复时不移动任何成员; 小对象两两比较,大对象才用哈希集合
+        void drop_shadowed_members(size_t base) {
+            size_t count = member_stack.size() - base;
+            auto* m = member_stack.data() + base;
+            bool duplicated = false;
+            if (count <= 16) {
+                for (size_t i = 1; i < count && !duplicated; i++)
+                    for (size_t j = 0; j < i && !duplicated; j++)
+                        duplicated = m[i].key == m[j].key;
+            }
+            else {
+                seen_keys.clear();
+                for (size_t i = 0; i < count && !duplicated; i++)
+                    duplicated = !seen_keys.insert(m[i].key).second;
+            }
+            if (!duplicated)
+                return;
+            seen_keys.clear();
+            size_t out = count;
+            for (size_t k = count; k-- > 0; )  // 从后往前,每个key第一次见到的就是最后出现的那个
+                if (seen_keys.insert(m[k].key).second)
+                    m[--out] = m[k];
+            member_stack.erase(member_stack.begin() + base, member_stack.begin() + base + out);
+        }
+
+        auto parse_node() -> std::optional<ArenaNode> {
+            parse_whitespace();
+            if (pos >= json_str.size()) {
+                return {};
+            }
+            switch (json_str[pos]) {
+                case '"': {
+                    auto str = parse_string_view();
+                    if (!str) {
+                        return {};
+                    }
+                    return ArenaNode::make_string(*str);
+                }
+                case '[':
+                    return parse_array_node();
+                case '{':
+                    return parse_object_node();
+                default: {
+                    auto value = parse_value();  // null/true/false/数字,不会分配内存
+                    if (!value) {
+                        return {};
+                    }
+                    if (auto v = std::get_if<Bool>(&*value))
+                        return ArenaNode::make_bool(*v);
+                    if (auto v = std::get_if<Int>(&*value))
+                        return ArenaNode::make_int(*v);
+                    if (auto v = std::get_if<Float>(&*value))
+                        return ArenaNode::make_float(*v);
+                    return ArenaNode{};
+                }
+            }
+        }
+    };
+
+    struct parse_options {
+        // 不带转义的字符串(包括key)直接引用输入,不复制; 这时输入必须比Document活得长
+        // 大部分key和字符串都没有转义,打开后arena里基本只剩节点本身
+        bool zero_copy = false;
+    };
+
+    // 解析成arena DOM; 第一块arena按输入长度预留(只是虚拟内存,用到才占物理页),一般一块就够
+    inline std::optional<Document> parse_document(std::string_view json_str, parse_options opt = {}) {
+        Document doc{ Arena{ json_str.size() } , {} };
+        auto index = build_structural_index(json_str);
+        ArenaParser p{ json_str, doc.arena, opt.zero_copy };
+        p.index = index.get();
+        auto root = p.parse_node();
+        if (!root) {
+            return {};
+        }
+        doc.root = *root;
+        return doc;
+    }
+
+
+    // ---------------- 按需(lazy)解析 ----------------
+    // 只建结构索引,不解析任何值; operator[]沿着索引往下走,没访问到的子树靠括号计数整个跳过
+    // 只有as_int()/as_string()/to_node()这些真正读值的调用才会解析对应的那一段
+    // 输入必须比LazyDocument和从它得到的LazyValue活得长; 格式错误只有在走到出错的地方时才会发现(抛异常)
+
+    class LazyValue {
+    public:
+        LazyValue(std::string_view _json_str, const StructuralIndex* _index, size_t _k) : json_str(_json_str), index(_index), k(_k) {}
+
+        Type type() const {
+            switch (first()) {
+                case '{': return Type::Object;
+                case '[': return Type::Array;
+                case '"': return Type::String;
+                case 't': case 'f': return Type::Bool;
+                case 'n': return Type::Null;
+                default: return std::holds_alternative<Int>(scalar()) ? Type::Int : Type::Float;
+            }
+        }
+        bool is_null() const { return first() == 'n'; }
+        bool is_array() const { return first() == '['; }  // 只看第一个字符,不解析也不抛类型异常
+        bool is_object() const { return first() == '{'; }
+        Bool as_bool() const {
+            auto value = scalar();
+            if (auto v = std::get_if<Bool>(&value))
+                return *v;
+            throw std::runtime_error("not a bool");
+        }
+        Int as_int() const {
+            auto value = scalar();
+            if (auto v = std::get_if<Int>(&value))
+                return *v;
+            throw std::runtime_error("not an int");
+        }
+        Float as_float() const {  // Int也可以当Float读
+            auto value = scalar();
+            if (auto v = std::get_if<Int>(&value))
+                return Float(*v);
+            if (auto v = std::get_if<Float>(&value))
+                return *v;
+            throw std::runtime_error("not a float");
+        }
+        std::string as_string() const {
+            if (first() != '"')
+                throw std::runtime_error("not a string");
+            return std::string{ decode(k) };
+        }
+        std::string_view raw() const {  // 这个值在输入里的原文
+            size_t begin = position(k);
+            size_t next = skip(k);
+            size_t end = first() == '{' || first() == '[' || first() == '"' ? position(next - 1) + 1 : next < index->count ? position(next) : json_str.size();
+            while (end > begin && is_whitespace(json_str[end - 1]))
+                end--;
+            return json_str.substr(begin, end - begin);
+        }
+
+        std::optional<LazyValue> find(std::string_view key) const {  // 对象里没有这个key返回nullopt; 重复的key以最后一个为准
+            if (first() != '{')
+                throw std::runtime_error("not an object");
+            std::optional<LazyValue> found;
+            for_each_member([&](std::string_view name, const LazyValue& value) {
+                if (name == key)
+                    found = value;
+            });
+            return found;
+        }
+        LazyValue operator[](std::string_view key) const {  // doc["abc"]
+            if (auto value = find(key))
+                return *value;
+            throw std::out_of_range("key not found");
+        }
+        std::optional<LazyValue> at(size_t i) const {  // 越界返回nullopt
+            if (first() != '[')
+                throw std::runtime_error("not an array");
+            size_t j = k + 1;
+            for (size_t n = 0; char_at(j) != ']'; n++) {
+                if (n == i)
+                    return LazyValue{ json_str, index, j };
+                j = next_element(skip(j), ']');
+            }
+            return {};
+        }
+        LazyValue operator[](size_t i) const {  // doc[2]
+            if (auto value = at(i))
+                return *value;
+            throw std::out_of_range("array index out of range");
+        }
+        size_t size() const {  // 数组元素个数/对象成员个数,其他类型是0
+            size_t n = 0;
+            if (first() == '[')
+                for_each_element([&](const LazyValue&) { n++; });
+            else if (first() == '{')
+                for_each_member([&](std::string_view, const LazyValue&) { n++; });
+            return n;
+        }
+
+        template<typename F>
+        void for_each_element(F&& f) const {  // f(const LazyValue&)
+            if (first() != '[')
+                throw std::runtime_error("not an array");
+            for (size_t j = k + 1; char_at(j) != ']'; j = next_element(skip(j), ']'))
+                f(LazyValue{ json_str, index, j });
+        }
+        template<typename F>
+        void for_each_member(F&& f) const {  // f(std::string_view key, const LazyValue&); key只在这次调用期间有效
+            if (first() != '{')
+                throw std::runtime_error("not an object");
+            for (size_t j = k + 1; char_at(j) != '}'; ) {
+                if (char_at(j) != '"' || char_at(j + 2) != ':')
+                    throw std::runtime_error("malformed json");
+                std::string key_buf;
+                std::string_view key = decode(j, key_buf);
+                f(key, LazyValue{ json_str, index, j + 3 });
+                j = next_element(skip(j + 3), '}');
+            }
+        }
+
+        Node to_node() const {  // 把这个值(和它的整个子树)解析成Node
+            JsonParser p{ json_str, position(k), index };
+            p.cursor = k;
+            auto value = p.parse_value();
+            if (!value)
+                throw std::runtime_error("malformed json");
+            return Node{ std::move(*value) };
+        }
+
+    private:
+        size_t position(size_t j) const {
+            if (j >= index->count)
+                throw std::runtime_error("malformed json");
+            return index->positions[j];
+        }
+        char char_at(size_t j) const { return json_str[position(j)]; }
+        char first() const { return char_at(k); }
+
+        // j是一个值的第一个token,返回这个值后面的那个token; 容器靠括号计数跳过,不看里面的内容
+        size_t skip(size_t j) const {
+            char c = char_at(j);
+            if (c == '"')
+                return j + 2;  // 开头和结尾的引号各是一个token
+            if (c != '{' && c != '[')
+                return j + 1;
+            size_t depth = 0;
+            for (;; j++) {
+                if (j >= index->count)
+                    throw std::runtime_error("malformed json");
+                char t = json_str[index->positions[j]];
+                if (t == '{' || t == '[')
+                    depth++;
+                else if ((t == '}' || t == ']') && --depth == 0)
+                    return j + 1;
+            }
+        }
+        size_t next_element(size_t j, char close) const {  // 一个元素之后: ','就指向下一个元素,结束括号就停在括号上
+            char c = char_at(j);
+            if (c == ',')
+                return j + 1;
+            if (c != close)
+                throw std::runtime_error("malformed json");
+            return j;
+        }
+        std::string_view decode(size_t j, std::string& buf) const {  // j是开头引号的token; 没有转义时直接返回原文
+            size_t begin = position(j) + 1;
+            std::string_view str = json_str.substr(begin, position(j + 1) - begin);
+            if (str.find('\\') == std::string_view::npos)
+                return str;
+            buf.resize(str.size());
+            size_t len = JsonParser::unescape(str, buf.data());
+            if (len == std::string_view::npos)
+                throw std::runtime_error("malformed json");
+            buf.resize(len);
+            return buf;
+        }
+        std::string decode(size_t j) const {
+            std::string buf;
+            std::string_view str = decode(j, buf);
+            return buf.empty() ? std::string{ str } : buf;
+        }
+        Value scalar() const {  // null/true/false/数字
+            if (first() == '"' || first() == '{' || first() == '[')
+                throw std::runtime_error("not a scalar");
+            JsonParser p{ json_str, position(k) };
+            auto value = p.parse_value();
+            if (!value)
+                throw std::runtime_error("malformed json");
+            return *value;
+        }
+
+        std::string_view json_str;
+        const StructuralIndex* index;
+        size_t k;  // 这个值的第一个token在index里的下标
+    };
+
+    class LazyDocument {
+    public:
+        LazyValue root() const { return LazyValue{ json_str, index.get(), 0 }; }
+        LazyValue operator[](std::string_view key) const { return root()[key]; }
+        LazyValue operator[](size_t i) const { return root()[i]; }
+
+        // 只建索引; 输入为空,超过4GB或者字符串没有结束时返回nullopt
+        // source是json_str所在的缓冲区(可以为空),LazyDocument持有它直到析构
+        static std::optional<LazyDocument> parse(std::string_view json_str, std::shared_ptr<const void> source = nullptr) {
+            auto index = build_structural_index(json_str);
+            if (!index || index->count == 0 || index->unclosed_string) {
+                return {};
+            }
+            LazyDocument doc;
+            doc.json_str = json_str;
+            doc.index = std::move(index);
+            doc.source = std::move(source);
+            return doc;
+        }
+
+    private:
+        std::string_view json_str;
+        std::unique_ptr<StructuralIndex> index;  // 放在堆上,LazyDocument移动之后已有的LazyValue仍然有效
+        std::shared_ptr<const void> source;
+    };
+
+    inline std::optional<LazyDocument> parse_lazy(std::string_view json_str) {
+        return LazyDocument::parse(json_str);
+    }
+
+
+    // ---------------- 从文件解析 ----------------
+
+    class MappedFile {  // 整个文件的只读视图: 优先mmap,不能mmap的(管道,/proc下的文件,不支持的平台)退回一次性读进内存
+    public:
+        explicit MappedFile(const std::string& path) {  // 打不开或者读失败抛std::system_error
+#if defined(__unix__) || defined(__APPLE__)
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                throw std::system_error(errno, std::generic_category(), "cannot open " + path);
+            }
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+                void* p = ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    ::madvise(p, size_t(st.st_size), MADV_SEQUENTIAL);  // 解析是从头到尾顺序读的,让内核多预读
+                    data = static_cast<const char*>(p);
+                    length = size_t(st.st_size);
+                    mapped = true;
+                    ::close(fd);
+                    return;
+                }
+            }
+            char chunk[64 * 1024];
+            for (;;) {
+                ssize_t n = ::read(fd, chunk, sizeof(chunk));
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n < 0) {
+                    int err = errno;
+                    ::close(fd);
+                    throw std::system_error(err, std::generic_category(), "cannot read " + path);
+                }
+                if (n == 0) {
+                    break;
+                }
+                buffer.append(chunk, size_t(n));
+            }
+            ::close(fd);
+#else
+            std::ifstream fin(path, std::ios::binary);
+            if (!fin) {
+                throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), "cannot open " + path);
+            }
+            buffer.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+#endif
+            data = buffer.data();
+            length = buffer.size();
+        }
+        ~MappedFile() {
+#if defined(__unix__) || defined(__APPLE__)
+            if (mapped) {
+                ::munmap(const_cast<char*>(data), length);
+            }
+#endif
+        }
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        std::string_view view() const { return { data, length }; }
+        bool is_mapped() const { return mapped; }
+
+    private:
+        const char* data = nullptr;
+        size_t length = 0;
+        bool mapped = false;
+        std::string buffer;  // read()退回时的内容
+    };
+
+    // 解析器不需要在输入末尾留填充字节(stage 1自己把最后不满64字节的一块补齐),所以直接把映射交给解析器,不再复制
+    inline std::optional<Node> parse_file(const std::string& path) {  // Node复制了所有字符串,返回前映射就释放了
+        MappedFile file{ path };
+        return parser(file.view());
+    }
+
+    // zero_copy时Document持有映射,字符串直接指向文件内容
+    inline std::optional<Document> parse_document_file(const std::string& path, parse_options opt = {}) {
+        auto file = std::make_shared<const MappedFile>(path);
+        auto doc = parse_document(file->view(), opt);
+        if (doc && opt.zero_copy) {
+            doc->source = std::move(file);
+        }
+        return doc;
+    }
+
+    inline std::optional<LazyDocument> parse_lazy_file(const std::string& path) {  // LazyDocument始终持有映射
+        auto file = std::make_shared<const MappedFile>(path);
+        return LazyDocument::parse(file->view(), file);
+    }
+
+
+    // ---------------- 流式(push)解析 ----------------
+    // 输入可以分成任意大小的块(比如socket每次read到的数据)依次喂进来,解析状态在块之间保留,不需要先把整个文档攒起来
+    // 解析结果以事件的形式交给Handler,Handler的要求和JsonParser::parse_events一样
+    // 和JsonParser不同,这里严格按JSON语法检查: 多余的逗号,缺少的冒号之类都算错误
+
+    enum class push_status { need_more, done, error };
+
+    template<typename Handler>
+    class PushParser {
+    public:
+        explicit PushParser(Handler& _handler) : handler(_handler) {}
+
+        push_status feed(std::string_view chunk) {
+            size_t i = 0;
+            while (i < chunk.size() && !failed) {
+                if (partial == token::string) {
+                    i = scan_string(chunk, i);
+                    continue;
+                }
+                if (partial == token::scalar) {
+                    i = scan_scalar(chunk, i);
+                    continue;
+                }
+                char c = chunk[i];
+                if (is_whitespace(c)) {
+                    i++;
+                    continue;
+                }
+                if (state == expect::done) {  // 一个完整的文档后面只能跟空白
+                    failed = true;
+                    break;
+                }
+                i = step(chunk, i);
+            }
+            return status();
+        }
+
+        push_status finish() {  // 输入结束; 顶层是数字时要靠它才知道数字已经结束,比如 "123"
+            if (partial == token::scalar && !failed) {
+                emit_scalar(buf);
+                buf.clear();
+                partial = token::none;
+            }
+            if (partial != token::none || state != expect::done) {
+                failed = true;
+            }
+            return status();
+        }
+
+        push_status status() const {
+            if (failed) {
+                return push_status::error;
+            }
+            return state == expect::done && partial == token::none ? push_status::done : push_status::need_more;
+        }
+
+        void reset() {  // 复用同一个PushParser解析下一个文档
+            stack.clear();
+            buf.clear();
+            state = expect::value;
+            partial = token::none;
+            failed = false;
+        }
+
+    private:
+        enum class expect : std::uint8_t {
+            value,        // 一个值
+            first_value,  // '['之后: 一个值或者']'
+            first_key,    // '{'之后: 一个key或者'}'
+            key,          // ','之后的key
+            colon,
+            comma,        // 值之后: ','或者结束当前容器
+            done,         // 顶层的值已经完整
+        };
+        enum class token : std::uint8_t { none, string, scalar };  // 被块边界截断,还没结束的token
+
+        static bool is_scalar_char(char c) {  // null/true/false/数字里可能出现的字符; 其余的非法字符也收进来,最后统一报错
+            switch (c) {
+                case ' ': case '\t': case '\n': case '\r':
+                case '{': case '}': case '[': case ']': case ':': case ',': case '"':
+                    return false;
+                default:
+                    return true;
+            }
+        }
+
+        size_t step(std::string_view chunk, size_t i) {  // 处理一个token的第一个字节
+            char c = chunk[i];
+            bool want_value = state == expect::value || state == expect::first_value;
+            switch (c) {
+                case '{':
+                case '[':
+                    if (!want_value) {
+                        return fail(i);
+                    }
+                    if (!(c == '{' ? handler.start_object() : handler.start_array())) {
+                        return fail(i);
+                    }
+                    stack.push_back(c);
+                    state = c == '{' ? expect::first_key : expect::first_value;
+                    return i + 1;
+                case '}':
+                case ']': {
+                    char open = c == '}' ? '{' : '[';
+                    bool can_close = state == expect::comma || state == (c == '}' ? expect::first_key : expect::first_value);
+                    if (!can_close || stack.empty() || stack.back() != open) {
+                        return fail(i);
+                    }
+                    stack.pop_back();
+                    if (!(c == '}' ? handler.end_object() : handler.end_array())) {
+                        return fail(i);
+                    }
+                    value_done();
+                    return i + 1;
+                }
+                case ',':
+                    if (state != expect::comma) {
+                        return fail(i);
+                    }
+                    state = stack.back() == '{' ? expect::key : expect::value;
+                    return i + 1;
+                case ':':
+                    if (state != expect::colon) {
+                        return fail(i);
+                    }
+                    state = expect::value;
+                    return i + 1;
+                case '"':
+                    if (!want_value && state != expect::first_key && state != expect::key) {
+                        return fail(i);
+                    }
+                    is_key = !want_value;
+                    has_escape = false;
+                    escape_pending = false;
+                    partial = token::string;
+                    return scan_string(chunk, i + 1);
+                default:
+                    if (!want_value) {
+                        return fail(i);
+                    }
+                    partial = token::scalar;
+                    return scan_scalar(chunk, i);
+            }
+        }
+
+        size_t scan_string(std::string_view chunk, size_t i) {  // i是字符串内容(或者上一块剩下的内容)在这一块里的起点
+            size_t start = i;
+            for (; i < chunk.size(); i++) {
+                char c = chunk[i];
+                if (escape_pending) {
+                    escape_pending = false;
+                    continue;
+                }
+                if (c == '\\') {
+                    escape_pending = true;
+                    has_escape = true;
+                    continue;
+                }
+                if (c == '"') {
+                    std::string_view raw = chunk.substr(start, i - start);
+                    if (!buf.empty()) {  // 字符串跨了块,前半截在buf里
+                        buf.append(raw);
+                        raw = buf;
+                    }
+                    partial = token::none;
+                    emit_string(raw);
+                    buf.clear();
+                    return i + 1;
+                }
+            }
+            buf.append(chunk.substr(start));
+            return chunk.size();
+        }
+
+        size_t scan_scalar(std::string_view chunk, size_t i) {
+            size_t start = i;
+            while (i < chunk.size() && is_scalar_char(chunk[i])) {
+                i++;
+            }
+            buf.append(chunk.substr(start, i - start));
+            if (i == chunk.size()) {
+                return i;  // 可能在下一块里继续
+            }
+            partial = token::none;
+            emit_scalar(buf);
+            buf.clear();
+            return i;
+        }
+
+        void emit_string(std::string_view raw) {
+            if (has_escape) {
+                decoded.resize(raw.size());
+                size_t len = JsonParser::unescape(raw, decoded.data());
+                if (len == std::string_view::npos) {
+                    fail(0);
+                    return;
+                }
+                raw = std::string_view{ decoded.data(), len };
+            }
+            if (is_key) {
+                if (!handler.on_key(raw)) {
+                    fail(0);
+                    return;
+                }
+                state = expect::colon;
+                return;
+            }
+            if (!handler.on_string(raw)) {
+                fail(0);
+                return;
+            }
+            value_done();
+        }
+
+        void emit_scalar(std::string_view raw) {
+            bool ok;
+            if (raw == "null") {
+                ok = handler.on_null();
+            }
+            else if (raw == "true" || raw == "false") {
+                ok = handler.on_bool(raw == "true");
+            }
+            else {
+                JsonParser p{ raw };
+                auto number = p.parse_number();
+                if (!number || p.pos != raw.size()) {
+                    fail(0);
+                    return;
+                }
+                if (auto v = std::get_if<Int>(&*number)) {
+                    ok = handler.on_int(*v);
+                }
+                else {
+                    ok = handler.on_float(std::get<Float>(*number));
+                }
+            }
+            if (!ok) {
+                fail(0);
+                return;
+            }
+            value_done();
+        }
+
+        void value_done() {
+            state = stack.empty() ? expect::done : expect::comma;
+        }
+
+        size_t fail(size_t i) {
+            failed = true;
+            return i;
+        }
+
+        Handler& handler;
+        std::vector<char> stack;  // 每一层容器的开括号, '{' 或 '['
+        std::string buf;  // 被块边界截断的token
+        std::string decoded;  // 带转义字符串的解码结果
+        expect state = expect::value;
+        token partial = token::none;
+        bool is_key = false;  // 当前字符串是不是key
+        bool has_escape = false;  // 当前字符串里有没有反斜杠
+        bool escape_pending = false;  // 上一块以没被转义的反斜杠结尾
+        bool failed = false;
+    };
+
+    // 解析json_str,结果以事件的形式交给handler,不构造Node
+    template<typename Handler>
+    bool parse_events(std::string_view json_str, Handler& handler) {
+        auto index = build_structural_index(json_str);
+        JsonParser p{ json_str, 0, index.get() };
+        return p.parse_events(handler);
+    }
+
+    // 从流里按块读取并解析,不用先把整个输入读进一个string
+    inline std::optional<Node> parser(std::istream& in, size_t chunk_size = 64 * 1024) {
+        DomBuilder builder;
+        PushParser<DomBuilder> p{ builder };
+        std::vector<char> chunk(chunk_size);
+        while (in && p.status() != push_status::error) {
+            in.read(chunk.data(), std::streamsize(chunk.size()));
+            p.feed(std::string_view{ chunk.data(), size_t(in.gcount()) });
+        }
+        if (p.finish() != push_status::done) {
+            return {};
+        }
+        return std::move(builder.result);
+    }
+
+
+    // ---------------- 输出 ----------------
+    // JsonWriter把所有内容追加到同一个缓冲区里: 不接sink时缓冲区就是结果,可以clear()之后复用;
+    // 接ostream或者文件描述符时,缓冲区超过flush_size就写出去,内存占用和输出大小无关
+    // 它同时也是一个事件Handler: parse_events(str, writer)就是把str原样压缩输出
+
+    inline size_t find_escape(const char* p, size_t n) {  // 第一个需要转义的字节(", \, 控制字符)的位置,没有就返回n
+        size_t i = 0;
+#if defined(JSON_SIMD_X86)
+        for (; i + 16 <= n; i += 16) {
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+            __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(c, _mm_set1_epi8(0x1F)), c);  // 无符号 c <= 0x1F
+            __m128i special = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('"')), _mm_cmpeq_epi8(c, _mm_set1_epi8('\\')));
+            int mask = _mm_movemask_epi8(_mm_or_si128(control, special));
+            if (mask != 0) {
+                return i + size_t(count_trailing_zeros(std::uint64_t(mask)));
+            }
+        }
+#elif defined(JSON_SIMD_NEON)
+        for (; i + 16 <= n; i += 16) {
+            uint8x16_t c = vld1q_u8(reinterpret_cast<const std::uint8_t*>(p + i));
+            uint8x16_t m = vorrq_u8(vcltq_u8(c, vdupq_n_u8(0x20)), vorrq_u8(vceqq_u8(c, vdupq_n_u8('"')), vceqq_u8(c, vdupq_n_u8('\\'))));
+            if (vmaxvq_u8(m) != 0) {
+                break;  // 这16个字节里有,交给下面逐字节找
+            }
+        }
+#endif
+        for (; i < n; i++) {
+            unsigned char c = static_cast<unsigned char>(p[i]);
+            if (c < 0x20 || c == '"' || c == '\\') {
+                return i;
+            }
+        }
+        return n;
+    }
+
+    class JsonWriter {
+    public:
+        JsonWriter() = default;  // 写进内部缓冲区,用str()/take()取结果
+        explicit JsonWriter(std::ostream& out, size_t _flush_size = 64 * 1024) : os(&out), flush_size(_flush_size) {
+            buf.reserve(flush_size);
+        }
+#if defined(__unix__) || defined(__APPLE__)
+        explicit JsonWriter(int _fd, size_t _flush_size = 64 * 1024) : fd(_fd), flush_size(_flush_size) {
+            buf.reserve(flush_size);
+        }
+#endif
+        JsonWriter(const JsonWriter&) = delete;
+        JsonWriter& operator=(const JsonWriter&) = delete;
+        ~JsonWriter() {
+            try {
+                flush();
+            }
+            catch (...) {}  // 析构函数里不能抛; 需要知道写出失败的话先手动flush()
+        }
+
+        const std::string& str() const { return buf; }
+        std::string take() {
+            std::string out = std::move(buf);
+            clear();
+            return out;
+        }
+        void clear() {  // 保留缓冲区的容量,开始写下一个文档
+            buf.clear();
+            levels.clear();
+            after_key = false;
+        }
+        void flush() {  // 没有sink时什么也不做
+            if (buf.empty() || (os == nullptr && fd < 0)) {
+                return;
+            }
+            if (os != nullptr) {
+                os->write(buf.data(), std::streamsize(buf.size()));
+            }
+#if defined(__unix__) || defined(__APPLE__)
+            else {
+                for (size_t done = 0; done < buf.size(); ) {
+                    ssize_t n = ::write(fd, buf.data() + done, buf.size() - done);
+                    if (n < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (n < 0) {
+                        throw std::system_error(errno, std::generic_category(), "JsonWriter write");
+                    }
+                    done += size_t(n);
+                }
+            }
+#endif
+            buf.clear();
+        }
+
+        void write(const Node& node) {
+            std::visit([this](auto&& arg) { write(arg); }, node.value);
+        }
+        void write(Null) { on_null(); }
+        void write(Bool v) { on_bool(v); }
+        void write(Int v) { on_int(v); }
+        void write(Float v) { on_float(v); }
+        void write(const String& v) { on_string(v); }
+        void write(const Array& array) {
+            start_array();
+            for (const auto& node : array) {
+                write(node);
+            }
+            end_array();
+        }
+        void write(const Object& object) {
+            start_object();
+            for (const auto& [key, node] : object) {
+                on_key(key);
+                write(node);
+            }
+            end_object();
+        }
+        void write(const ArenaNode& node) {
+            switch (node.type()) {
+                case Type::Null: on_null(); break;
+                case Type::Bool: on_bool(node.b); break;
+                case Type::Int: on_int(node.i); break;
+                case Type::Float: on_float(node.f); break;
+                case Type::String: on_string(node.as_string()); break;
+                case Type::Array:
+                    start_array();
+                    for (const auto& item : node.elements()) {
+                        write(item);
+                    }
+                    end_array();
+                    break;
+                case Type::Object:
+                    start_object();
+                    for (const auto& [key, value] : node.fields()) {
+                        on_key(key);
+                        write(value);
+                    }
+                    end_object();
+                    break;
+            }
+        }
+
+        // Handler接口
+        bool on_null() {
+            before_value();
+            buf += "null";
+            return after_value();
+        }
+        bool on_bool(Bool v) {
+            before_value();
+            buf += v ? "true" : "false";
+            return after_value();
+        }
+        bool on_int(Int v) {
+            before_value();
+            char tmp[24];
+            auto res = std::to_chars(tmp, tmp + sizeof(tmp), v);
+            buf.append(tmp, size_t(res.ptr - tmp));
+            return after_value();
+        }
+        bool on_float(Float v) {  // 最短的能精确还原的表示; JSON没有inf/nan,输出null
+            before_value();
+            if (!std::isfinite(v)) {
+                buf += "null";
+                return after_value();
+            }
+            char tmp[32];
+#if defined(__cpp_lib_to_chars)
+            auto res = std::to_chars(tmp, tmp + sizeof(tmp), v);
+            std::string_view out{ tmp, size_t(res.ptr - tmp) };
+#else
+            std::string_view out{ tmp, size_t(std::snprintf(tmp, sizeof(tmp), "%.17g", v)) };
+#endif
+            buf += out;
+            if (out.find_first_of(".eE") == std::string_view::npos) {
+                buf += ".0";  // 25.0输出成"25"的话,重新解析会变成Int
+            }
+            return after_value();
+        }
+        bool on_string(std::string_view str) {
+            before_value();
+            write_escaped(str);
+            return after_value();
+        }
+        bool on_key(std::string_view key) {
+            before_value();
+            write_escaped(key);
+            buf += ':';
+            after_key = true;
+            return true;
+        }
+        bool start_object() {
+            before_value();
+            buf += '{';
+            levels.push_back(false);
+            return true;
+        }
+        bool end_object() {
+            levels.pop_back();
+            buf += '}';
+            return after_value();
+        }
+        bool start_array() {
+            before_value();
+            buf += '[';
+            levels.push_back(false);
+            return true;
+        }
+        bool end_array() {
+            levels.pop_back();
+            buf += ']';
+            return after_value();
+        }
+
+    private:
+        void before_value() {  // 同一层的第二个及以后的值前面加逗号; key后面的值不加
+            if (after_key) {
+                after_key = false;
+                return;
+            }
+            if (!levels.empty()) {
+                if (levels.back()) {
+                    buf += ',';
+                }
+                levels.back() = true;
+            }
+        }
+        bool after_value() {
+            if (buf.size() >= flush_size) {
+                flush();
+            }
+            return true;
+        }
+        void write_escaped(std::string_view str) {  // 不需要转义的部分整段复制
+            buf += '"';
+            for (size_t i = 0; i < str.size(); ) {
+                size_t clean = find_escape(str.data() + i, str.size() - i);
+                buf.append(str.data() + i, clean);
+                i += clean;
+                if (i == str.size()) {
+                    break;
+                }
+                char c = str[i++];
+                switch (c) {
+                    case '"': buf += "\\\""; break;
+                    case '\\': buf += "\\\\"; break;
+                    case '\b': buf += "\\b"; break;
+                    case '\f': buf += "\\f"; break;
+                    case '\n': buf += "\\n"; break;
+                    case '\r': buf += "\\r"; break;
+                    case '\t': buf += "\\t"; break;
+                    default: {
+                        static const char hex[] = "0123456789abcdef";
+                        buf += "\\u00";
+                        buf += hex[(c >> 4) & 0xF];
+                        buf += hex[c & 0xF];
+                    }
+                }
+            }
+            buf += '"';
+        }
+
+        std::string buf;
+        std::vector<bool> levels;  // 每一层容器里是否已经写过值
+        bool after_key = false;
+        std::ostream* os = nullptr;
+        int fd = -1;
+        size_t flush_size = std::numeric_limits<size_t>::max();  // 没有sink时永远不flush
+    };
+
+    // ---------------- 结构体绑定 ----------------
+    // 业务代码拿到Node之后通常马上用一串std::get_if把它转成结构体; 用JSON_REFLECT登记结构体的字段之后,
+    // parse_as<T>直接从输入解析进T,generate(T)直接从T输出,中间不构造Node
+    // 字段名在编译期算出一个完美哈希表: 解析时每个key只算一次哈希,比较一次字符串,就跳到对应字段的解析函数
+    //
+    //     struct Point { double x = 0; double y = 0; std::vector<std::string> tags; };
+    //     JSON_REFLECT(Point, x, y, tags)  // 写在Point所在的命名空间里(不能写在类里面),最多24个字段,只能是public成员
+    //     auto p = json::parse_as<Point>(R"({"x": 1, "y": 2.5, "tags": ["a"]})");
+    //     std::string s = json::generate(*p);
+    //
+    // 支持的字段类型: bool, 整数, 浮点数, std::string, std::optional<U>, std::vector<U>, std::map<std::string, U>,
+    // Node(原样保留这一段), 以及其他登记过的结构体
+    // 输入里没有的字段保持原来的值,不认识的key跳过; 类型不对(包括整数超出字段类型的范围)解析失败
+
+    template<typename C, typename M>
+    struct field {
+        std::string_view name;
+        M C::* member;
+    };
+
+    template<typename C, typename M>
+    constexpr field<C, M> make_field(std::string_view name, M C::* member) {
+        return { name, member };
+    }
+
+    template<typename T, typename = void>
+    struct is_reflected : std::false_type {};
+    template<typename T>  // json_fields由JSON_REFLECT定义,通过ADL找到
+    struct is_reflected<T, std::void_t<decltype(json_fields(static_cast<const T*>(nullptr)))>> : std::true_type {};
+    template<typename T>
+    inline constexpr bool is_reflected_v = is_reflected<T>::value;
+
+    constexpr std::uint64_t fnv1a(std::string_view str, std::uint64_t seed) {
+        std::uint64_t h = 14695981039346656037ull ^ seed;
+        for (char c : str) {
+            h ^= std::uint8_t(c);
+            h *= 1099511628211ull;
+        }
+        return h ^ (h >> 32);  // FNV的低位分布比较差,把高位混进来再取掩码
+    }
+
+    template<size_t N>
+    struct field_table {  // 槽位数是不小于4N的2的幂,找一个让所有字段名都落在不同槽位的seed
+        static constexpr size_t slots = [] { size_t n = 1; while (n < 4 * N) n *= 2; return n; }();
+        static constexpr std::uint8_t empty = 0xFF;
+        std::uint64_t seed = 0;
+        std::array<std::uint8_t, slots> index{};
+
+        constexpr int find(std::string_view key, const std::array<std::string_view, N>& names) const {
+            std::uint8_t i = index[fnv1a(key, seed) & (slots - 1)];
+            return i != empty && names[i] == key ? int(i) : -1;
+        }
+    };
+
+    template<size_t N>
+    constexpr field_table<N> make_field_table(const std::array<std::string_view, N>& names) {
+        static_assert(N < field_table<N>::empty, "too many fields");
+        for (size_t i = 0; i < N; i++) {
+            for (size_t j = i + 1; j < N; j++) {
+                if (names[i] == names[j]) {
+                    throw std::logic_error("duplicate field name");  // 在常量求值里执行到throw就是编译错误
+                }
+            }
+        }
+        field_table<N> table;
+        for (std::uint64_t seed = 0; seed < 4096; seed++) {
+            table.seed = seed;
+            for (auto& i : table.index) {
+                i = table.empty;
+            }
+            bool ok = true;
+            for (size_t i = 0; i < N && ok; i++) {
+                auto& slot = table.index[fnv1a(names[i], seed) & (table.slots - 1)];
+                ok = slot == table.empty;
+                slot = std::uint8_t(i);
+            }
+            if (ok) {
+                return table;
+            }
+        }
+        throw std::logic_error("no perfect hash seed found");
+    }
+
+    template<typename T>
+    bool read_json(JsonParser& p, T& out);
+
+    template<typename T>
+    struct reflection {  // 一个登记过的结构体在编译期算好的东西
+        static constexpr auto fields = json_fields(static_cast<const T*>(nullptr));
+        static constexpr size_t size = std::tuple_size_v<std::decay_t<decltype(fields)>>;
+
+        template<size_t... I>
+        static constexpr std::array<std::string_view, size> make_names(std::index_sequence<I...>) {
+            return { std::get<I>(fields).name... };
+        }
+        static constexpr std::array<std::string_view, size> names = make_names(std::make_index_sequence<size>{});
+        static constexpr field_table<size> table = make_field_table(names);
+
+        template<size_t I>
+        static bool read_field(JsonParser& p, T& out) {
+            return read_json(p, out.*(std::get<I>(fields).member));
+        }
+        using reader = bool (*)(JsonParser&, T&);
+        template<size_t... I>
+        static constexpr std::array<reader, size> make_readers(std::index_sequence<I...>) {
+            return { &read_field<I>... };
+        }
+        static constexpr std::array<reader, size> readers = make_readers(std::make_index_sequence<size>{});
+    };
+
+    struct SkipHandler {  // 不认识的字段: 照常检查语法,什么也不保存
+        bool on_null() { return true; }
+        bool on_bool(Bool) { return true; }
+        bool on_int(Int) { return true; }
+        bool on_float(Float) { return true; }
+        bool on_string(std::string_view) { return true; }
+        bool on_key(std::string_view) { return true; }
+        bool start_object() { return true; }
+        bool end_object() { return true; }
+        bool start_array() { return true; }
+        bool end_array() { return true; }
+    };
+
+    template<typename T> struct is_optional : std::false_type {};
+    template<typename U> struct is_optional<std::optional<U>> : std::true_type {};
+    template<typename T> struct is_vector : std::false_type {};
+    template<typename U, typename A> struct is_vector<std::vector<U, A>> : std::true_type {};
+    template<typename T> struct is_string_map : std::false_type {};
+    template<typename U, typename C, typename A> struct is_string_map<std::map<std::string, U, C, A>> : std::true_type {};
+    template<typename T> struct dependent_false : std::false_type {};
+
+    // [ ... ]和{ ... }的循环, 语法和parse_events一样宽松; item(p)解析一个元素,对象的item(p, key)解析key后面的值
+    template<typename F>
+    bool read_json_array(JsonParser& p, F&& item) {
+        p.pos++;  // [
+        p.parse_whitespace();
+        while (p.pos < p.json_str.size() && p.json_str[p.pos] != ']') {
+            if (!item(p)) {
+                return false;
+            }
+            p.parse_whitespace();
+            if (p.pos < p.json_str.size() && p.json_str[p.pos] == ',') {
+                p.pos++;  // ,
+            }
+            p.parse_whitespace();
+        }
+        if (p.pos >= p.json_str.size()) {
+            return false;
+        }
+        p.pos++;  // ]
+        return true;
+    }
+
+    template<typename F>
+    bool read_json_object(JsonParser& p, F&& member) {
+        p.pos++;  // {
+        p.parse_whitespace();
+        while (p.pos < p.json_str.size() && p.json_str[p.pos] != '}') {
+            if (p.json_str[p.pos] != '"') {
+                return false;
+            }
+            auto key = p.parse_string_raw();  // 带转义的key在scratch里,下一个字符串会覆盖它,member必须先用完key
+            if (!key) {
+                return false;
+            }
+            p.parse_whitespace();
+            if (p.pos < p.json_str.size() && p.json_str[p.pos] == ':') {
+                p.pos++;  // :
+            }
+            if (!member(p, *key)) {
+                return false;
+            }
+            p.parse_whitespace();
+            if (p.pos < p.json_str.size() && p.json_str[p.pos] == ',') {
+                p.pos++;  // ,
+            }
+            p.parse_whitespace();
+        }
+        if (p.pos >= p.json_str.size()) {
+            return false;
+        }
+        p.pos++;  // }
+        return true;
+    }
+
+    // 从p.pos解析一个值到out; 失败时out可能只填了一部分
+    template<typename T>
+    bool read_json(JsonParser& p, T& out) {
+        p.parse_whitespace();
+        if (p.pos >= p.json_str.size()) {
+            return false;
+        }
+        char c = p.json_str[p.pos];
+        if constexpr (std::is_same_v<T, bool>) {
+            auto value = c == 't' ? p.parse_true() : p.parse_false();
+            if (!value) {
+                return false;
+            }
+            out = std::get<Bool>(*value);
+            return true;
+        }
+        else if constexpr (std::is_integral_v<T>) {
+            auto value = p.parse_number();
+            auto i = value ? std::get_if<Int>(&*value) : nullptr;
+            if (i == nullptr) {
+                return false;
+            }
+            if constexpr (std::is_signed_v<T>) {
+                if (*i < Int(std::numeric_limits<T>::min()) || *i > Int(std::numeric_limits<T>::max())) {
+                    return false;
+                }
+            }
+            else {
+                if (*i < 0 || std::uint64_t(*i) > std::uint64_t(std::numeric_limits<T>::max())) {
+                    return false;
+                }
+            }
+            out = T(*i);
+            return true;
+        }
+        else if constexpr (std::is_floating_point_v<T>) {
+            auto value = p.parse_number();
+            if (!value) {
+                return false;
+            }
+            auto i = std::get_if<Int>(&*value);
+            out = i != nullptr ? T(*i) : T(std::get<Float>(*value));
+            return true;
+        }
+        else if constexpr (std::is_same_v<T, std::string>) {
+            auto str = c == '"' ? p.parse_string_raw() : std::nullopt;
+            if (!str) {
+                return false;
+            }
+            out.assign(str->data(), str->size());
+            return true;
+        }
+        else if constexpr (is_optional<T>::value) {
+            if (c == 'n') {
+                out.reset();
+                return p.parse_null().has_value();
+            }
+            return read_json(p, out.emplace());
+        }
+        else if constexpr (is_vector<T>::value) {
+            if (c != '[') {
+                return false;
+            }
+            out.clear();
+            return read_json_array(p, [&](JsonParser& p) { return read_json(p, out.emplace_back()); });
+        }
+        else if constexpr (is_string_map<T>::value) {
+            if (c != '{') {
+                return false;
+            }
+            out.clear();
+            return read_json_object(p, [&](JsonParser& p, std::string_view key) { return read_json(p, out[std::string{ key }]); });
+        }
+        else if constexpr (std::is_same_v<T, Node>) {
+            auto value = p.parse_value();
+            if (!value) {
+                return false;
+            }
+            out.value = std::move(*value);
+            return true;
+        }
+        else if constexpr (is_reflected_v<T>) {
+            if (c != '{') {
+                return false;
+            }
+            using R = reflection<T>;
+            return read_json_object(p, [&](JsonParser& p, std::string_view key) {
+                int i = R::table.find(key, R::names);
+                if (i < 0) {
+                    SkipHandler skip;
+                    return p.parse_events(skip);
+                }
+                return R::readers[size_t(i)](p, out);
+            });
+        }
+        else {
+            static_assert(dependent_false<T>::value, "type is not bindable, register it with JSON_REFLECT");
+            return false;
+        }
+    }
+
+    template<typename T>
+    void write_json(JsonWriter& w, const T& value) {
+        if constexpr (std::is_same_v<T, bool>) {
+            w.on_bool(value);
+        }
+        else if constexpr (std::is_integral_v<T>) {
+            w.on_int(Int(value));  // 超过int64_t的uint64_t会变成负数,JSON里的整数本来也只保证int64_t
+        }
+        else if constexpr (std::is_floating_point_v<T>) {
+            w.on_float(Float(value));
+        }
+        else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            w.on_string(value);
+        }
+        else if constexpr (is_optional<T>::value) {
+            if (value) {
+                write_json(w, *value);
+            }
+            else {
+                w.on_null();
+            }
+        }
+        else if constexpr (is_vector<T>::value) {
+            w.start_array();
+            for (const auto& item : value) {
+                write_json(w, item);
+            }
+            w.end_array();
+        }
+        else if constexpr (is_string_map<T>::value) {
+            w.start_object();
+            for (const auto& [key, item] : value) {
+                w.on_key(key);
+                write_json(w, item);
+            }
+            w.end_object();
+        }
+        else if constexpr (std::is_same_v<T, Node>) {
+            w.write(value);
+        }
+        else if constexpr (is_reflected_v<T>) {
+            w.start_object();
+            std::apply([&](const auto&... f) { ((w.on_key(f.name), write_json(w, value.*(f.member))), ...); }, reflection<T>::fields);
+            w.end_object();
+        }
+        else {
+            static_assert(dependent_false<T>::value, "type is not bindable, register it with JSON_REFLECT");
+        }
+    }
+
+    // 解析整个json_str到out; 和parser一样先建stage 1索引
+    template<typename T>
+    bool parse_into(std::string_view json_str, T& out) {
+        auto index = build_structural_index(json_str);
+        JsonParser p{ json_str, 0, index.get() };
+        return read_json(p, out);
+    }
+
+    template<typename T>
+    std::optional<T> parse_as(std::string_view json_str) {
+        std::optional<T> out{ std::in_place };
+        if (!parse_into(json_str, *out)) {
+            return {};
+        }
+        return out;
+    }
+
+#define JSON_EXPAND_(x) x
+#define JSON_FIELD_(m) ::json::make_field(#m, &json_self::m)
+#define JSON_FE_1(f, x) f(x)
+#define JSON_FE_2(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_1(f, __VA_ARGS__))
+#define JSON_FE_3(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_2(f, __VA_ARGS__))
+#define JSON_FE_4(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_3(f, __VA_ARGS__))
+#define JSON_FE_5(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_4(f, __VA_ARGS__))
+#define JSON_FE_6(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_5(f, __VA_ARGS__))
+#define JSON_FE_7(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_6(f, __VA_ARGS__))
+#define JSON_FE_8(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_7(f, __VA_ARGS__))
+#define JSON_FE_9(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_8(f, __VA_ARGS__))
+#define JSON_FE_10(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_9(f, __VA_ARGS__))
+#define JSON_FE_11(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_10(f, __VA_ARGS__))
+#define JSON_FE_12(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_11(f, __VA_ARGS__))
+#define JSON_FE_13(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_12(f, __VA_ARGS__))
+#define JSON_FE_14(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_13(f, __VA_ARGS__))
+#define JSON_FE_15(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_14(f, __VA_ARGS__))
+#define JSON_FE_16(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_15(f, __VA_ARGS__))
+#define JSON_FE_17(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_16(f, __VA_ARGS__))
+#define JSON_FE_18(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_17(f, __VA_ARGS__))
+#define JSON_FE_19(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_18(f, __VA_ARGS__))
+#define JSON_FE_20(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_19(f, __VA_ARGS__))
+#define JSON_FE_21(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_20(f, __VA_ARGS__))
+#define JSON_FE_22(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_21(f, __VA_ARGS__))
+#define JSON_FE_23(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_22(f, __VA_ARGS__))
+#define JSON_FE_24(f, x, ...) f(x), JSON_EXPAND_(JSON_FE_23(f, __VA_ARGS__))
+#define JSON_FE_PICK_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, NAME, ...) NAME
+#define JSON_FOR_EACH_(f, ...) JSON_EXPAND_(JSON_FE_PICK_(__VA_ARGS__, JSON_FE_24, JSON_FE_23, JSON_FE_22, JSON_FE_21, JSON_FE_20, JSON_FE_19, JSON_FE_18, \
+    JSON_FE_17, JSON_FE_16, JSON_FE_15, JSON_FE_14, JSON_FE_13, JSON_FE_12, JSON_FE_11, JSON_FE_10, JSON_FE_9, JSON_FE_8, JSON_FE_7, JSON_FE_6, JSON_FE_5, \
+    JSON_FE_4, JSON_FE_3, JSON_FE_2, JSON_FE_1)(f, __VA_ARGS__))
+
+    // JSON_REFLECT(Type, field1, field2, ...): JSON里的key就是成员名
+#define JSON_REFLECT(Type, ...) \
+    constexpr auto json_fields(const Type*) { \
+        using json_self = Type; \
+        return std::make_tuple(JSON_FOR_EACH_(JSON_FIELD_, __VA_ARGS__)); \
+    }
+
+    class JsonGenerator {  // 以前每一层都返回一个新的string再拼接; 现在都交给JsonWriter,接口保持不变
+    public:
+        static auto generate(const Node& node) -> std::string {
+            return write_to_string(node);
+        }
+        static auto generate(const ArenaNode& node) -> std::string {
+            return write_to_string(node);
+        }
+        static auto generate_string(std::string_view str) -> std::string {
+            JsonWriter writer;
+            writer.on_string(str);
+            return writer.take();
+        }
+        static auto generate_array(const Array& array) -> std::string {
+            return write_to_string(array);
+        }
+        static auto generate_object(const Object& object) -> std::string {
+            return write_to_string(object);
+        }
+        template<typename T>
+        static auto generate_value(const T& value) -> std::string {  // 登记过的结构体,以及绑定支持的其他类型
+            JsonWriter writer;
+            write_json(writer, value);
+            return writer.take();
+        }
+
+    private:
+        template<typename T>
+        static std::string write_to_string(const T& value) {
+            JsonWriter writer;
+            writer.write(value);
+            return writer.take();
+        }
+    };
+
+    inline std::string generate(const Node& node) {
+        return JsonGenerator::generate(node);
+    }
+
+    inline std::string generate(const ArenaNode& node) {
+        return JsonGenerator::generate(node);
+    }
+
+    template<typename T, typename = std::enable_if_t<is_reflected_v<T>>>
+    std::string generate(const T& value) {
+        return JsonGenerator::generate_value(value);
+    }
+
+
+    inline std::ostream& operator << (std::ostream& out, const Node& t) {
+        JsonWriter{ out }.write(t);  // 直接写进流,不先拼成string
+        return out;
+    }
+
+    inline std::ostream& operator << (std::ostream& out, const ArenaNode& t) {
+        JsonWriter{ out }.write(t);
+        return out;
+    }
+    
+}
@@ -0,0 +1,144 @@
+#pragma once
+#include "json.h"
+#include "threadpool.h"
+#include <deque>
+#include <future>
+
+// 换行分隔的JSON(NDJSON, 每行一个文档)的并行解析:
+// 输入按换行切成几MB的块,每块交给线程池里的一个worker解析成一个NdjsonBatch,调用线程按输入顺序依次拿到这些batch
+// 同时在解析的块数有上限,内存占用和输入大小无关; 调用线程只负责切块和等结果,不要在pool自己的worker里调用
+
+namespace json {
+
+    struct ndjson_options {
+        size_t chunk_size = 4 << 20;  // 每块大约多少字节,实际会延伸到下一个换行
+        size_t max_in_flight = 0;  // 最多同时有多少块在解析或等待回调, 0表示线程数的2倍
+        parse_options parse{ true };  // 默认zero_copy: 字符串直接指向输入,输入必须比batch活得长
+    };
+
+    struct NdjsonBatch {  // 一块里解析出来的所有文档
+        Arena arena;  // 只属于这一块,在解析它的worker上分配(first-touch落在那个worker所在的节点)
+        std::vector<ArenaNode> docs;  // 按行的顺序,空行跳过
+        std::vector<size_t> bad_lines;  // 解析失败的行,整个输入里的行号(从0开始)
+        size_t first_line = 0;  // 这一块第一行在整个输入里的行号
+        size_t num_lines = 0;
+        std::shared_ptr<const void> source;  // 从文件读的时候,zero_copy的字符串指向的映射
+    };
+
+    // 解析一块(完整的若干行); 索引和解析器的栈是每个线程一份,块与块之间复用
+    inline NdjsonBatch parse_ndjson_chunk(std::string_view chunk, parse_options opt) {
+        thread_local StructuralIndex index;
+        thread_local std::vector<ArenaNode> item_stack;
+        thread_local std::vector<ArenaMember> member_stack;
+        NdjsonBatch batch{ Arena{ opt.zero_copy ? chunk.size() / 2 : chunk.size() }, {}, {}, 0, 0, nullptr };
+        ArenaParser p{ {}, batch.arena, opt.zero_copy };
+        p.index = &index;
+        p.item_stack.swap(item_stack);  // 借用这个线程上次留下的栈,用完还回去
+        p.member_stack.swap(member_stack);
+        size_t line = 0;
+        for (size_t begin = 0; begin < chunk.size(); line++) {
+            size_t end = chunk.find('\n', begin);
+            if (end == std::string_view::npos) {
+                end = chunk.size();
+            }
+            std::string_view text = chunk.substr(begin, end - begin);
+            begin = end + 1;
+            while (!text.empty() && is_whitespace(text.back())) {  // 包括Windows换行的'\r'
+                text.remove_suffix(1);
+            }
+            while (!text.empty() && is_whitespace(text.front())) {
+                text.remove_prefix(1);
+            }
+            if (text.empty()) {
+                continue;
+            }
+            std::optional<ArenaNode> root;
+            if (build_structural_index(text, index) && !index.unclosed_string) {
+                p.json_str = text;
+                p.pos = 0;
+                p.cursor = 0;
+                p.item_stack.clear();  // 上一行失败时可能留下半截
+                p.member_stack.clear();
+                root = p.parse_node();
+            }
+            if (root && p.pos == text.size()) {
+                batch.docs.push_back(*root);
+            }
+            else {
+                batch.bad_lines.push_back(line);
+            }
+        }
+        batch.num_lines = line;
+        p.item_stack.swap(item_stack);
+        p.member_stack.swap(member_stack);
+        return batch;
+    }
+
+    // 并行解析input,按输入顺序在调用线程上依次调用on_batch(NdjsonBatch&&),返回解析成功的文档数
+    // on_batch抛出异常,或者某一块的结果是异常(比如reject策略的queue_full)时,等已经提交的块都结束(它们还在读input)再把异常抛出去
+    template<typename Pool, typename F>
+    size_t for_each_ndjson(Pool& pool, std::string_view input, F&& on_batch, ndjson_options opt = {}, std::shared_ptr<const void> source = nullptr) {
+        size_t max_in_flight = opt.max_in_flight != 0 ? opt.max_in_flight : std::max<size_t>(2, 2 * pool.threads.size());
+        std::deque<std::future<NdjsonBatch>> in_flight;
+        size_t next_line = 0;
+        size_t num_docs = 0;
+        auto deliver = [&]() {
+            auto front = std::move(in_flight.front());
+            in_flight.pop_front();  // 先出队再get: get抛出(比如queue_full)时下面的catch不会再去wait一个已经取过结果的future
+            NdjsonBatch batch = front.get();
+            batch.first_line = next_line;
+            for (auto& line : batch.bad_lines) {
+                line += next_line;
+            }
+            next_line += batch.num_lines;
+            num_docs += batch.docs.size();
+            if (opt.parse.zero_copy) {
+                batch.source = source;
+            }
+            on_batch(std::move(batch));
+        };
+        try {
+            for (size_t begin = 0; begin < input.size(); ) {
+                size_t end = std::min(input.size(), begin + std::max<size_t>(opt.chunk_size, 1));
+                if (end < input.size()) {  // 延伸到下一个换行,每块都是完整的行
+                    size_t newline = input.find('\n', end);
+                    end = newline == std::string_view::npos ? input.size() : newline + 1;
+                }
+                std::string_view chunk = input.substr(begin, end - begin);
+                begin = end;
+                if (in_flight.size() >= max_in_flight) {
+                    deliver();
+                }
+                in_flight.push_back(pool.submit([chunk, popt = opt.parse]() { return parse_ndjson_chunk(chunk, popt); }));
+            }
+            while (!in_flight.empty()) {
+                deliver();
+            }
+        }
+        catch (...) {
+            for (auto& f : in_flight) {
+                if (f.valid()) {
+                    f.wait();
+                }
+            }
+            throw;
+        }
+        return num_docs;
+    }
+
+    // 一次拿到所有batch; zero_copy(默认)时input必须比返回的batch活得长
+    template<typename Pool>
+    std::vector<NdjsonBatch> parse_ndjson(Pool& pool, std::string_view input, ndjson_options opt = {}) {
+        std::vector<NdjsonBatch> batches;
+        for_each_ndjson(pool, input, [&](NdjsonBatch&& batch) { batches.push_back(std::move(batch)); }, opt);
+        return batches;
+    }
+
+    // mmap文件再并行解析; zero_copy时每个batch都持有映射,回调之后留着batch也是安全的
+    template<typename Pool, typename F>
+    size_t for_each_ndjson_file(Pool& pool, const std::string& path, F&& on_batch, ndjson_options opt = {}) {
+        auto file = std::make_shared<const MappedFile>(path);
+        return for_each_ndjson(pool, file->view(), std::forward<F>(on_batch), opt, file);
+    }
+
+}
@@ -0,0 +1,214 @@
+#pragma once
+#include "json.h"
+#include "threadpool.h"
+#include <future>
+
+// 单个大数组文档的并行解析: NDJSON可以按行切,一个巨大的顶层数组只能在元素之间切
+// 先建结构索引,沿着索引找到顶层数组里深度为1的逗号,在这些位置把数组切成几段,每段交给线程池里的一个worker解析
+// 每段有自己的arena(Node版本就是自己的Array),最后按顺序拼起来; 顶层不是数组或者输入太小时退回串行解析
+// 调用线程会等所有段解析完,不要在pool自己的worker里调用
+
+namespace json {
+
+    struct parallel_parse_options {
+        size_t min_segment_size = 1 << 20;  // 每段至少多少字节,输入不到两段时直接串行解析
+        size_t max_segments = 0;  // 最多切成几段, 0表示线程数的4倍(段的大小不均匀时worker之间还能互相补上)
+        parse_options parse{};  // 只对parse_document_parallel有效
+    };
+
+    struct ArraySegment {  // 顶层数组里连续的若干个元素,用index里的下标表示
+        size_t first;  // 第一个元素的第一个token
+        size_t last;  // 最后一个元素之后的','或者结束的']'
+    };
+
+    // 沿着索引找到json_str顶层数组的分段点,每段大约step字节; 顶层不是数组,或者数组没有结束时返回false
+    inline bool split_top_level_array(std::string_view json_str, const StructuralIndex& index, size_t step, std::vector<ArraySegment>& segments) {
+        segments.clear();
+        if (index.count == 0 || index.unclosed_string || json_str[index.positions[0]] != '[') {
+            return false;
+        }
+        size_t depth = 0;
+        size_t first = 1;
+        size_t cut = index.positions[0] + step;
+        for (size_t j = 0; j < index.count; j++) {
+            size_t p = index.positions[j];
+            switch (json_str[p]) {
+                case '"':
+                    j++;  // 开头和结尾的引号各是一个token
+                    break;
+                case '[':
+                case '{':
+                    depth++;
+                    break;
+                case ']':
+                case '}':
+                    if (--depth == 0) {
+                        segments.push_back({ first, j });
+                        return true;
+                    }
+                    break;
+                case ',':
+                    if (depth == 1 && p >= cut) {
+                        segments.push_back({ first, j });
+                        first = j + 1;
+                        cut = p + step;
+                    }
+                    break;
+            }
+        }
+        return false;
+    }
+
+    namespace detail {
+        // 把每一段交给parse_one(const ArraySegment&)并行解析,按顺序返回结果
+        // 任务引用着调用者的输入和索引: 先等所有段都结束,再取结果(可能抛出其中的异常)
+        template<typename Pool, typename F>
+        auto parse_segments(Pool& pool, const std::vector<ArraySegment>& segments, F parse_one) {
+            using R = std::invoke_result_t<F&, const ArraySegment&>;
+            std::vector<std::future<R>> futures;
+            futures.reserve(segments.size());
+            try {
+                for (const auto& segment : segments) {
+                    futures.push_back(pool.submit([&parse_one, &segment]() { return parse_one(segment); }));
+                }
+            }
+            catch (...) {
+                for (auto& f : futures) {
+                    f.wait();
+                }
+                throw;
+            }
+            for (auto& f : futures) {
+                f.wait();
+            }
+            std::vector<R> results;
+            results.reserve(segments.size());
+            for (auto& f : futures) {
+                results.push_back(f.get());
+            }
+            return results;
+        }
+
+        inline size_t segment_step(size_t size, size_t threads, const parallel_parse_options& opt) {  // 0表示不值得切
+            size_t max_segments = opt.max_segments != 0 ? opt.max_segments : 4 * std::max<size_t>(threads, 1);
+            size_t segments = std::min(max_segments, size / std::max<size_t>(opt.min_segment_size, 1));
+            return segments < 2 ? 0 : size / segments;
+        }
+    }
+
+    // parse_document的并行版本: 结果还是一个Document,各段的arena都并进doc.arena
+    template<typename Pool>
+    std::optional<Document> parse_document_parallel(Pool& pool, std::string_view json_str, parallel_parse_options opt = {}) {
+        size_t step = detail::segment_step(json_str.size(), pool.threads.size(), opt);
+        if (step == 0) {
+            return parse_document(json_str, opt.parse);
+        }
+        auto index = build_structural_index(json_str);
+        std::vector<ArraySegment> segments;
+        if (!index || !split_top_level_array(json_str, *index, step, segments)) {
+            return parse_document(json_str, opt.parse);
+        }
+
+        struct Part {
+            Arena arena;
+            std::vector<ArenaNode> items;
+            bool ok = false;
+        };
+        auto parts = detail::parse_segments(pool, segments, [&](const ArraySegment& segment) {
+            size_t begin = index->positions[segment.first];
+            size_t end = index->positions[segment.last];
+            Part part{ Arena{ opt.parse.zero_copy ? (end - begin) / 2 : end - begin }, {}, false };
+            ArenaParser p{ json_str, part.arena, opt.parse.zero_copy };
+            p.index = index.get();
+            p.pos = begin;
+            p.cursor = segment.first;
+            while (p.pos < end) {  // 和parse_array_node里的循环一样,只是停在这一段的结尾
+                auto value = p.parse_node();
+                if (!value) {
+                    return part;
+                }
+                part.items.push_back(*value);
+                p.parse_whitespace();
+                if (p.pos < end && json_str[p.pos] == ',') {
+                    p.pos++;  // ,
+                }
+                p.parse_whitespace();
+            }
+            part.ok = p.pos == end;
+            return part;
+        });
+
+        size_t count = 0;
+        for (const auto& part : parts) {
+            if (!part.ok) {
+                return {};
+            }
+            count += part.items.size();
+        }
+        Document doc{ Arena{ count * sizeof(ArenaNode) }, {} };
+        ArenaNode* items = count == 0 ? nullptr : static_cast<ArenaNode*>(doc.arena.allocate(count * sizeof(ArenaNode), alignof(ArenaNode)));
+        size_t n = 0;
+        for (auto& part : parts) {
+            if (!part.items.empty()) {
+                std::memcpy(static_cast<void*>(items + n), part.items.data(), part.items.size() * sizeof(ArenaNode));
+            }
+            n += part.items.size();
+            doc.arena.adopt(std::move(part.arena));  // 元素里的字符串和子树还在各段的arena里
+        }
+        doc.root = ArenaNode::make_array(items, count);
+        return doc;
+    }
+
+    // parser(json_str)的并行版本: 每段解析成一个Array,最后按顺序移动进同一个Array
+    template<typename Pool>
+    std::optional<Node> parser_parallel(Pool& pool, std::string_view json_str, parallel_parse_options opt = {}) {
+        size_t step = detail::segment_step(json_str.size(), pool.threads.size(), opt);
+        if (step == 0) {
+            return parser(json_str);
+        }
+        auto index = build_structural_index(json_str);
+        std::vector<ArraySegment> segments;
+        if (!index || !split_top_level_array(json_str, *index, step, segments)) {
+            JsonParser p{ json_str, 0, index.get() };
+            return p.parse();
+        }
+
+        auto parts = detail::parse_segments(pool, segments, [&](const ArraySegment& segment) -> std::optional<Array> {
+            size_t end = index->positions[segment.last];
+            JsonParser p{ json_str, index->positions[segment.first], index.get() };
+            p.cursor = segment.first;
+            Array array;
+            while (p.pos < end) {
+                auto value = p.parse_value();
+                if (!value) {
+                    return {};
+                }
+                array.emplace_back(std::move(*value));
+                p.parse_whitespace();
+                if (p.pos < end && json_str[p.pos] == ',') {
+                    p.pos++;  // ,
+                }
+                p.parse_whitespace();
+            }
+            if (p.pos != end) {
+                return {};
+            }
+            return array;
+        });
+
+        size_t count = 0;
+        for (const auto& part : parts) {
+            if (!part) {
+                return {};
+            }
+            count += part->size();
+        }
+        Array array;
+        array.reserve(count);
+        for (auto& part : parts) {
+            std::move(part->begin(), part->end(), std::back_inserter(array));
+        }
+        return Node{ std::move(array) };
+    }
+
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include "json.h"
+
+// JSON Pointer(RFC 6901): "/configurations/2/name"先编译成一串step,之后每次查询只是沿着step往下走
+// 查不到(key不存在,下标越界,中途遇到的不是数组/对象)都返回nullptr/nullopt,不抛异常
+// 同一个pointer可以查Node, ArenaNode和LazyValue; 查LazyValue时只解析路径上的key,其余的子树靠结构索引整个跳过
+
+namespace json {
+
+    class JsonPointer {
+    public:
+        struct Step {
+            std::string key;  // 已经把~1和~0还原成/和~
+            size_t index;  // key是合法的数组下标(0或者不以0开头的数字)时就是它的值,否则是npos
+        };
+        static constexpr size_t npos = std::string_view::npos;
+
+        // ""是整个文档; 不是以'/'开头,或者'~'后面不是0/1时返回nullopt
+        static std::optional<JsonPointer> compile(std::string_view pointer) {
+            JsonPointer ptr;
+            ptr.text = pointer;
+            if (pointer.empty()) {
+                return ptr;
+            }
+            if (pointer[0] != '/') {
+                return {};
+            }
+            size_t begin = 1;
+            while (true) {
+                size_t end = pointer.find('/', begin);
+                auto token = pointer.substr(begin, end == npos ? npos : end - begin);
+                Step step;
+                step.key.reserve(token.size());
+                for (size_t i = 0; i < token.size(); i++) {
+                    if (token[i] != '~') {
+                        step.key += token[i];
+                        continue;
+                    }
+                    if (i + 1 == token.size() || (token[i + 1] != '0' && token[i + 1] != '1')) {
+                        return {};
+                    }
+                    step.key += token[++i] == '0' ? '~' : '/';
+                }
+                step.index = parse_index(step.key);
+                ptr.path.push_back(std::move(step));
+                if (end == npos) {
+                    break;
+                }
+                begin = end + 1;
+            }
+            return ptr;
+        }
+
+        const std::string& str() const { return text; }
+        const std::vector<Step>& steps() const { return path; }
+        size_t size() const { return path.size(); }
+
+        Node* find(Node& root) const { return walk(&root); }
+        const Node* find(const Node& root) const { return walk(&root); }
+
+        const ArenaNode* find(const ArenaNode& root) const {
+            const ArenaNode* node = &root;
+            for (const auto& step : path) {
+                if (node->type() == Type::Object) {
+                    node = node->find(step.key);
+                }
+                else if (node->type() == Type::Array && step.index < node->size()) {
+                    node = &(*node)[step.index];
+                }
+                else {
+                    node = nullptr;
+                }
+                if (!node) {
+                    return nullptr;
+                }
+            }
+            return node;
+        }
+
+        // 输入本身格式错误时LazyValue照常抛异常,只有"没找到"是nullopt
+        std::optional<LazyValue> find(const LazyValue& root) const {
+            std::optional<LazyValue> node = root;
+            for (const auto& step : path) {
+                if (node->is_object()) {
+                    node = node->find(step.key);
+                }
+                else if (node->is_array() && step.index != npos) {
+                    node = node->at(step.index);
+                }
+                else {
+                    node.reset();
+                }
+                if (!node) {
+                    return {};
+                }
+            }
+            return node;
+        }
+        std::optional<LazyValue> find(const LazyDocument& doc) const { return find(doc.root()); }
+
+    private:
+        static size_t parse_index(std::string_view token) {  // "-"(数组末尾之后)和"01"这种都不是下标
+            if (token.empty() || (token[0] == '0' && token.size() > 1)) {
+                return npos;
+            }
+            size_t index = 0;
+            auto [end, ec] = std::from_chars(token.data(), token.data() + token.size(), index);
+            if (ec != std::errc{} || end != token.data() + token.size() || index == npos) {
+                return npos;
+            }
+            return index;
+        }
+
+        template<typename N>
+        N* walk(N* node) const {  // N是Node或者const Node
+            for (const auto& step : path) {
+                if (auto object = std::get_if<Object>(&node->value)) {
+                    auto it = object->find(step.key);
+                    node = it != object->end() ? &it->second : nullptr;
+                }
+                else if (auto array = std::get_if<Array>(&node->value); array && step.index < array->size()) {
+                    node = &(*array)[step.index];
+                }
+                else {
+                    node = nullptr;
+                }
+                if (!node) {
+                    return nullptr;
+                }
+            }
+            return node;
+        }
+
+        std::string text;
+        std::vector<Step> path;
+    };
+
+}
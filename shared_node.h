@@ -0,0 +1,287 @@
+#pragma once
+#include "json.h"
+#include <atomic>
+
+// 结构共享(copy-on-write)的Node: 字符串,数组,对象都放在引用计数的共享存储里,复制一个SharedNode只是引用计数加一
+// 通过非const的operator[]/push/erase修改时,只有还在和别人共享的那一层容器会被复制(浅复制,元素仍然共享),
+// 所以一次修改只复制从根到被修改节点的那条路径,没有碰到的子树继续和原来的副本共享
+// 多个线程各自拿一个副本之后,读和修改自己的副本都不需要加锁; 同一个SharedNode对象不能同时被多个线程修改
+
+namespace json {
+
+    // SharedNode的共享存储: 和shared_ptr一样复制时计数加一,多了一个unique()
+    // shared_ptr::use_count()是relaxed读,看到1之后还得单独加一个acquire fence,TSan不认这种写法
+    // 这里直接用acquire读计数: 看到1说明别的副本都已经析构(release),它们之前对存储的读都结束了,可以原地修改
+    template<typename T>
+    class CowPtr {
+    public:
+        CowPtr() = default;
+        CowPtr(const CowPtr& other) : b(other.b) {
+            if (b)
+                b->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+        CowPtr(CowPtr&& other) noexcept : b(std::exchange(other.b, nullptr)) {}
+        CowPtr& operator=(CowPtr other) noexcept {
+            std::swap(b, other.b);
+            return *this;
+        }
+        ~CowPtr() {
+            if (b && b->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                delete b;
+        }
+
+        template<typename... Args>
+        static CowPtr make(Args&&... args) {
+            CowPtr p;
+            p.b = new block(std::forward<Args>(args)...);
+            return p;
+        }
+
+        bool unique() const { return b->refs.load(std::memory_order_acquire) == 1; }
+        T& operator*() const { return b->value; }
+        T* operator->() const { return &b->value; }
+        bool operator==(const CowPtr& other) const { return b == other.b; }
+
+    private:
+        struct block {
+            template<typename... Args>
+            explicit block(Args&&... args) : value(std::forward<Args>(args)...) {}
+            std::atomic<size_t> refs{ 1 };
+            T value;
+        };
+        block* b = nullptr;
+    };
+
+    class SharedNode;
+    using SharedArray = std::vector<SharedNode>;
+    using SharedObject = std::map<std::string, SharedNode, std::less<>>;  // less<>: find可以直接用string_view
+
+    class SharedNode {
+    public:
+        SharedNode() = default;  // null
+        SharedNode(Null) {}
+        SharedNode(Bool v) : value(v) {}
+        template<typename T, typename = std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+        SharedNode(T v) : value(Int(v)) {}
+        SharedNode(Float v) : value(v) {}
+        SharedNode(const char* v) : SharedNode(String{ v }) {}
+        SharedNode(std::string_view v) : SharedNode(String{ v }) {}
+        SharedNode(String v) : value(StringPtr::make(std::move(v))) {}
+        SharedNode(SharedArray v) : value(ArrayPtr::make(std::move(v))) {}
+        SharedNode(SharedObject v) : value(ObjectPtr::make(std::move(v))) {}
+        explicit SharedNode(const Node& node) { std::visit([this](const auto& arg) { assign(arg); }, node.value); }  // 复制整棵树,只在开始时做一次
+        explicit SharedNode(Node&& node) { std::visit([this](auto&& arg) { assign(std::move(arg)); }, node.value); }  // 字符串移动过来,不复制
+
+        Type type() const { return Type(value.index()); }  // 备选类型的顺序和Type一致
+        bool is_null() const { return type() == Type::Null; }
+        Bool as_bool() const {
+            if (auto v = std::get_if<Bool>(&value))
+                return *v;
+            throw std::runtime_error("not a bool");
+        }
+        Int as_int() const {
+            if (auto v = std::get_if<Int>(&value))
+                return *v;
+            throw std::runtime_error("not an int");
+        }
+        Float as_float() const {  // Int也可以当Float读
+            if (auto v = std::get_if<Int>(&value))
+                return Float(*v);
+            if (auto v = std::get_if<Float>(&value))
+                return *v;
+            throw std::runtime_error("not a float");
+        }
+        const String& as_string() const {
+            if (auto v = std::get_if<StringPtr>(&value))
+                return **v;
+            throw std::runtime_error("not a string");
+        }
+        const SharedArray& elements() const {
+            if (auto v = std::get_if<ArrayPtr>(&value))
+                return **v;
+            throw std::runtime_error("not an array");
+        }
+        const SharedObject& fields() const {
+            if (auto v = std::get_if<ObjectPtr>(&value))
+                return **v;
+            throw std::runtime_error("not an object");
+        }
+        size_t size() const {  // 数组元素个数/对象成员个数,其他类型是0
+            if (auto v = std::get_if<ArrayPtr>(&value))
+                return (*v)->size();
+            if (auto v = std::get_if<ObjectPtr>(&value))
+                return (*v)->size();
+            return 0;
+        }
+
+        // ---- 只读访问: 不复制任何东西 ----
+        const SharedNode* find(std::string_view key) const {  // 找不到返回nullptr
+            const auto& object = fields();
+            auto it = object.find(key);
+            return it != object.end() ? &it->second : nullptr;
+        }
+        // key只接受能转换成string_view的类型: 字面量0不会被当成空指针的const char*,node[0]只匹配下标的重载
+        template<typename K, typename = std::enable_if_t<std::is_convertible_v<K, std::string_view> && !std::is_integral_v<std::decay_t<K>>>>
+        const SharedNode& operator[](K&& key) const {  // 不插入,没有这个key就抛异常
+            if (auto node = find(std::string_view{ key }))
+                return *node;
+            throw std::out_of_range("key not found");
+        }
+        const SharedNode& operator[](size_t index) const { return elements().at(index); }
+
+        // ---- 修改: 这一层容器还在共享时先复制一份 ----
+        template<typename K, typename = std::enable_if_t<std::is_convertible_v<K, std::string_view> && !std::is_integral_v<std::decay_t<K>>>>
+        SharedNode& operator[](K&& key) {  // 和Node一样,没有这个key就插入null; 传入的std::string&&会被移动进去
+            auto& object = mutable_object();
+            auto it = object.find(std::string_view{ key });
+            return it != object.end() ? it->second : object.emplace(std::string{ std::forward<K>(key) }, SharedNode{}).first->second;
+        }
+        SharedNode& operator[](size_t index) {
+            if (index >= elements().size())  // 越界时不复制
+                throw std::out_of_range("array index out of range");
+            return mutable_array()[index];
+        }
+        void push(SharedNode node) {
+            mutable_array().push_back(std::move(node));
+        }
+        size_t erase(std::string_view key) {  // 没有这个key时不复制
+            if (find(key) == nullptr)
+                return 0;
+            auto& object = mutable_object();
+            object.erase(object.find(key));
+            return 1;
+        }
+
+        bool shares(const SharedNode& other) const {  // 两个节点是不是指向同一份字符串/容器
+            return std::visit([&](const auto& a) {
+                using T = std::decay_t<decltype(a)>;
+                if constexpr (std::is_same_v<T, StringPtr> || std::is_same_v<T, ArrayPtr> || std::is_same_v<T, ObjectPtr>) {
+                    auto b = std::get_if<T>(&other.value);
+                    return b != nullptr && *b == a;
+                }
+                else {
+                    return false;
+                }
+            }, value);
+        }
+
+        Node to_node() const {  // 转换成普通的Node(深复制)
+            switch (type()) {
+                case Type::Null: return Node{};
+                case Type::Bool: return Node{ as_bool() };
+                case Type::Int: return Node{ as_int() };
+                case Type::Float: return Node{ as_float() };
+                case Type::String: return Node{ as_string() };
+                case Type::Array: {
+                    Array array;
+                    array.reserve(size());
+                    for (const auto& item : elements())
+                        array.push_back(item.to_node());
+                    return Node{ std::move(array) };
+                }
+                default: {
+                    Object object;
+                    for (const auto& [key, item] : fields())
+                        object.try_emplace(key, item.to_node());
+                    return Node{ std::move(object) };
+                }
+            }
+        }
+
+        template<typename Handler>
+        bool write_events(Handler& h) const {  // 以事件的形式交给Handler(JsonWriter, CborWriter, DomBuilder...)
+            switch (type()) {
+                case Type::Null: return h.on_null();
+                case Type::Bool: return h.on_bool(as_bool());
+                case Type::Int: return h.on_int(as_int());
+                case Type::Float: return h.on_float(as_float());
+                case Type::String: return h.on_string(as_string());
+                case Type::Array:
+                    if (!h.start_array())
+                        return false;
+                    for (const auto& item : elements())
+                        if (!item.write_events(h))
+                            return false;
+                    return h.end_array();
+                default:
+                    if (!h.start_object())
+                        return false;
+                    for (const auto& [key, item] : fields())
+                        if (!h.on_key(key) || !item.write_events(h))
+                            return false;
+                    return h.end_object();
+            }
+        }
+
+    private:
+        using StringPtr = CowPtr<const String>;
+        using ArrayPtr = CowPtr<SharedArray>;
+        using ObjectPtr = CowPtr<SharedObject>;
+
+        template<typename T>
+        static T& unshare(CowPtr<T>& p) {
+            if (!p.unique()) {
+                p = CowPtr<T>::make(*p);  // 浅复制: 元素的引用计数加一
+            }
+            return *p;
+        }
+        SharedArray& mutable_array() {
+            if (auto v = std::get_if<ArrayPtr>(&value))
+                return unshare(*v);
+            throw std::runtime_error("not an array");
+        }
+        SharedObject& mutable_object() {
+            if (auto v = std::get_if<ObjectPtr>(&value))
+                return unshare(*v);
+            throw std::runtime_error("not an object");
+        }
+
+        void assign(Null) {}
+        void assign(Bool v) { value = v; }
+        void assign(Int v) { value = v; }
+        void assign(Float v) { value = v; }
+        template<typename S, typename = std::enable_if_t<std::is_same_v<std::decay_t<S>, String>>>
+        void assign(S&& v) { value = StringPtr::make(std::forward<S>(v)); }
+        void assign(const Array& array) {
+            SharedArray items;
+            items.reserve(array.size());
+            for (const auto& node : array)
+                items.emplace_back(node);
+            value = ArrayPtr::make(std::move(items));
+        }
+        void assign(Array&& array) {
+            SharedArray items;
+            items.reserve(array.size());
+            for (auto& node : array)
+                items.emplace_back(std::move(node));
+            value = ArrayPtr::make(std::move(items));
+        }
+        void assign(const Object& object) {
+            SharedObject members;
+            for (const auto& [key, node] : object)
+                members.emplace_hint(members.end(), std::string{ std::string_view{ key } }, node);  // Object也是按key排好序的
+            value = ObjectPtr::make(std::move(members));
+        }
+        void assign(Object&& object) {
+            SharedObject members;
+            for (auto& [key, node] : object)
+                members.emplace_hint(members.end(), std::string{ std::string_view{ key } }, std::move(node));
+            value = ObjectPtr::make(std::move(members));
+        }
+
+        std::variant<Null, Bool, Int, Float, StringPtr, ArrayPtr, ObjectPtr> value;
+    };
+
+    inline std::string generate(const SharedNode& node) {
+        JsonWriter writer;
+        node.write_events(writer);
+        return writer.take();
+    }
+
+    inline std::ostream& operator << (std::ostream& out, const SharedNode& t) {
+        JsonWriter writer{ out };
+        t.write_events(writer);
+        return out;
+    }
+
+}
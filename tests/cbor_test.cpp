@@ -0,0 +1,115 @@
+#include "cbor.h"
+#include <gtest/gtest.h>
+#include <cmath>
+
+using namespace json;
+
+namespace {
+
+    std::string bytes(std::initializer_list<int> list) {
+        std::string out;
+        for (int b : list)
+            out += char(b);
+        return out;
+    }
+
+    const std::vector<std::string> documents = {
+        R"({"a":1,"b":[true,false,null],"c":{"d":"e"}})",
+        R"([0,23,24,255,256,65535,65536,4294967295,4294967296,9223372036854775807,-1,-24,-25,-256,-257,-9223372036854775808])",
+        R"([1.5,-0.25,1e300,0.1,3.4028234663852886e38,1e-45])",
+        R"({"esc":"q\"uote é 😀","empty":"","arr":[],"obj":{},"nested":[[[{"k":[null]}]]]})",
+        "\"just a string\"",
+        "42",
+        "null",
+    };
+
+}
+
+TEST(Cbor, NodeRoundTrip) {
+    for (const auto& text : documents) {
+        SCOPED_TRACE(text);
+        auto node = parser(text);
+        ASSERT_TRUE(node.has_value());
+        auto back = from_cbor(to_cbor(*node));
+        ASSERT_TRUE(back.has_value());
+        EXPECT_EQ(generate(*back), generate(*node));
+    }
+}
+
+TEST(Cbor, ArenaAndEventPathsDecodeToTheSameNode) {
+    for (const auto& text : documents) {
+        SCOPED_TRACE(text);
+        auto expected = generate(parser(text).value());
+        auto doc = parse_document(text);
+        ASSERT_TRUE(doc.has_value());
+        auto from_arena = from_cbor(to_cbor(doc->root));
+        ASSERT_TRUE(from_arena.has_value());
+        EXPECT_EQ(generate(*from_arena), expected);
+
+        CborWriter writer;  // 事件路径: 数组和对象是不定长的
+        ASSERT_TRUE(parse_events(text, writer));
+        auto from_events = from_cbor(writer.str());
+        ASSERT_TRUE(from_events.has_value());
+        EXPECT_EQ(generate(*from_events), expected);
+    }
+}
+
+TEST(Cbor, IntegersUseTheShortestHead) {
+    EXPECT_EQ(to_cbor(Node{ Int(0) }), bytes({ 0x00 }));
+    EXPECT_EQ(to_cbor(Node{ Int(23) }), bytes({ 0x17 }));
+    EXPECT_EQ(to_cbor(Node{ Int(24) }), bytes({ 0x18, 0x18 }));
+    EXPECT_EQ(to_cbor(Node{ Int(255) }), bytes({ 0x18, 0xFF }));
+    EXPECT_EQ(to_cbor(Node{ Int(256) }), bytes({ 0x19, 0x01, 0x00 }));
+    EXPECT_EQ(to_cbor(Node{ Int(65535) }), bytes({ 0x19, 0xFF, 0xFF }));
+    EXPECT_EQ(to_cbor(Node{ Int(65536) }), bytes({ 0x1A, 0x00, 0x01, 0x00, 0x00 }));
+    EXPECT_EQ(to_cbor(Node{ Int(1) << 32 }), bytes({ 0x1B, 0, 0, 0, 1, 0, 0, 0, 0 }));
+    EXPECT_EQ(to_cbor(Node{ Int(-1) }), bytes({ 0x20 }));
+    EXPECT_EQ(to_cbor(Node{ Int(-25) }), bytes({ 0x38, 0x18 }));
+    EXPECT_EQ(to_cbor(Node{ std::numeric_limits<Int>::min() }), bytes({ 0x3B, 0x7F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }));
+    for (Int v : { std::numeric_limits<Int>::min(), std::numeric_limits<Int>::max(), Int(-65537), Int(4294967295) }) {
+        auto back = from_cbor(to_cbor(Node{ v }));
+        ASSERT_TRUE(back.has_value());
+        EXPECT_EQ(std::get<Int>(back->value), v);
+    }
+    // 超出int64_t的整数和JSON解析一样读成Float
+    auto big = from_cbor(bytes({ 0x1B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }));
+    ASSERT_TRUE(big.has_value());
+    EXPECT_EQ(std::get<Float>(big->value), 18446744073709551615.0);
+}
+
+TEST(Cbor, FloatsUseFourBytesOnlyWhenExact) {
+    EXPECT_EQ(to_cbor(Node{ 1.5 }), bytes({ 0xFA, 0x3F, 0xC0, 0x00, 0x00 }));
+    EXPECT_EQ(to_cbor(Node{ 1.1 }), bytes({ 0xFB, 0x3F, 0xF1, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9A }));
+    EXPECT_EQ(to_cbor(Node{ std::numeric_limits<Float>::infinity() }).size(), 5u);
+    EXPECT_EQ(to_cbor(Node{ Float(std::numeric_limits<float>::max()) }).size(), 5u);
+    EXPECT_EQ(to_cbor(Node{ -Float(std::numeric_limits<float>::max()) }).size(), 5u);
+    for (Float v : { 3.5e38, -1e39, 1e300, std::numeric_limits<Float>::max() })  // 超出float范围的不能先转换成float再比较
+        EXPECT_EQ(to_cbor(Node{ v }).size(), 9u) << v;
+    for (Float v : { 0.1, -0.0, 1e300, 5e-324, std::numeric_limits<Float>::infinity() }) {
+        auto back = from_cbor(to_cbor(Node{ v }));
+        ASSERT_TRUE(back.has_value());
+        Float f = std::get<Float>(back->value);
+        EXPECT_EQ(f, v);
+        EXPECT_EQ(std::signbit(f), std::signbit(v));
+    }
+    auto nan = from_cbor(to_cbor(Node{ std::numeric_limits<Float>::quiet_NaN() }));
+    ASSERT_TRUE(nan.has_value());
+    EXPECT_TRUE(std::isnan(std::get<Float>(nan->value)));
+    auto half = from_cbor(bytes({ 0xF9, 0x3E, 0x00 }));  // 半精度的1.5,自己不写但要能读
+    ASSERT_TRUE(half.has_value());
+    EXPECT_EQ(std::get<Float>(half->value), 1.5);
+}
+
+TEST(Cbor, MalformedInputReturnsNullopt) {
+    auto encoded = to_cbor(parser(documents[0]).value());
+    for (size_t n = 0; n < encoded.size(); n++)  // 任何位置截断都不行
+        EXPECT_FALSE(from_cbor(std::string_view(encoded).substr(0, n)).has_value()) << n;
+    EXPECT_FALSE(from_cbor(encoded + '\x00').has_value());          // 后面多余的字节
+    EXPECT_FALSE(from_cbor(bytes({ 0x9F, 0x01 })).has_value());    // 不定长数组没有break
+    EXPECT_FALSE(from_cbor(bytes({ 0xA1, 0x01, 0x02 })).has_value());  // key不是文本
+    EXPECT_FALSE(from_cbor(bytes({ 0x1C })).has_value());          // 保留的info
+    EXPECT_FALSE(from_cbor(bytes({ 0xFF })).has_value());          // 容器外的break
+    EXPECT_FALSE(from_cbor(bytes({ 0x9B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF })).has_value());  // 长度不可信
+    EXPECT_FALSE(from_cbor(std::string(CborReader::max_depth + 2, char(0x81)) + '\x00').has_value());
+    EXPECT_TRUE(from_cbor(std::string(CborReader::max_depth, char(0x81)) + '\x00').has_value());
+}
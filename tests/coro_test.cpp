@@ -0,0 +1,83 @@
+#include "coro.h"
+#include <gtest/gtest.h>
+
+namespace {
+
+    constexpr size_t many_hops = 200000;
+
+    // 1个worker,容量1: worker被blocker占住,唯一的空位被filler占住,之后外部线程的每次提交都遇到满队列
+    struct saturated_pool {
+        std::atomic<bool> started{ false };
+        std::atomic<bool> release{ false };
+        ThreadPool<> pool;
+
+        explicit saturated_pool(overflow_policy on_full) : pool(1, options(on_full)) {
+            pool.post([this] {
+                started.store(true);
+                while (!release.load())
+                    std::this_thread::yield();
+            });
+            while (!started.load())  // blocker出队之后它的空位才还回来
+                std::this_thread::yield();
+            pool.post([] {});
+        }
+        ~saturated_pool() { release.store(true); }
+
+        static pool_options options(overflow_policy on_full) {
+            pool_options o;
+            o.capacity = 1;
+            o.on_full = on_full;
+            return o;
+        }
+    };
+
+    template<typename Pool>
+    coro::task<size_t> hop(Pool& pool, size_t n, std::thread::id expected) {  // 返回有几次跳转之后不在expected线程上
+        size_t moved = 0;
+        for (size_t i = 0; i < n; i++) {
+            co_await pool.schedule();
+            moved += std::this_thread::get_id() != expected;
+        }
+        co_return moved;
+    }
+
+}
+
+TEST(CoroSchedule, FullCallerRunsPoolContinuesInlineWithoutGrowingTheStack) {
+    saturated_pool s{ overflow_policy::caller_runs };
+    EXPECT_EQ(coro::sync_wait(hop(s.pool, many_hops, std::this_thread::get_id())), 0u);
+}
+
+TEST(CoroSchedule, FullRejectingPoolContinuesInline) {
+    saturated_pool s{ overflow_policy::reject };
+    EXPECT_EQ(coro::sync_wait(hop(s.pool, many_hops, std::this_thread::get_id())), 0u);
+}
+
+TEST(CoroSchedule, FullPoolSeenFromItsWorkerContinuesInline) {
+    ThreadPool<> pool(1, saturated_pool::options(overflow_policy::block));  // worker遇到满队列时不看on_full,总是就地执行
+    auto on_worker = [&pool]() -> coro::task<size_t> {
+        co_await pool.schedule();
+        auto worker = std::this_thread::get_id();
+        pool.post([] {});  // 占住唯一的空位: 唯一的worker正在执行这个协程,filler一直排着
+        co_return co_await hop(pool, many_hops, worker);
+    };
+    EXPECT_EQ(coro::sync_wait(on_worker()), 0u);
+}
+
+TEST(CoroSchedule, QueuedHopResumesOnAWorker) {
+    ThreadPool pool(2);
+    EXPECT_EQ(coro::sync_wait(hop(pool, 1000, std::this_thread::get_id())), 1000u);
+    EXPECT_EQ(coro::sync_wait(coro::run_on(pool, [] { return 42; })), 42);
+}
+
+TEST(CoroSchedule, FullLockfreeRingSeenFromItsWorkerContinuesInline) {
+    ThreadPool<lockfree_queue> pool(1);  // 没有容量上限,admit总是queued; 但环形缓冲区只有1024个槽
+    auto on_worker = [&pool]() -> coro::task<size_t> {
+        co_await pool.schedule();
+        auto worker = std::this_thread::get_id();
+        for (int i = 0; i < 1100; i++)  // 唯一的worker正在执行这个协程,环形缓冲区被填满,多出来的就地执行
+            pool.post([] {});
+        co_return co_await hop(pool, many_hops, worker);
+    };
+    EXPECT_EQ(coro::sync_wait(on_worker()), 0u);
+}
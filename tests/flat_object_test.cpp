@@ -0,0 +1,68 @@
+#include "json.h"
+#include <gtest/gtest.h>
+
+// 这个测试用JSON_FLAT_OBJECT编译(见CMakeLists.txt),Object就是FlatObject<std::string, Node>
+using namespace json;
+
+static_assert(std::is_same_v<Object, FlatObject<std::string, Node>>);
+
+namespace {
+
+    std::string unsorted_object(int n) {  // {"k<n-1>":0,...,"k0":n-1}: key是逆序的
+        std::string text = "{";
+        for (int i = n - 1; i >= 0; i--)
+            text += "\"k" + std::to_string(i) + "\":" + std::to_string(n - 1 - i) + ",";
+        text.back() = '}';
+        return text;
+    }
+
+}
+
+TEST(FlatObject, FromMembersSortsAndKeepsTheLastDuplicate) {
+    std::vector<Object::value_type> members;
+    members.emplace_back("b", Node{ Int{ 1 } });
+    members.emplace_back("a", Node{ Int{ 2 } });
+    members.emplace_back("b", Node{ Int{ 3 } });
+    members.emplace_back("c", Node{ Int{ 4 } });
+    members.emplace_back("a", Node{ Int{ 5 } });
+    auto object = Object::from_members(std::move(members));
+    ASSERT_EQ(object.size(), 3u);
+    std::string keys;
+    for (auto& [key, value] : object)
+        keys += key;
+    EXPECT_EQ(keys, "abc");
+    EXPECT_EQ(std::get<Int>(object.at("a").value), 5);
+    EXPECT_EQ(std::get<Int>(object.at("b").value), 3);
+    EXPECT_EQ(std::get<Int>(object.at("c").value), 4);
+}
+
+TEST(FlatObject, InternedKeysFromMembers) {
+    using Interned = FlatObject<InternedKey, int>;
+    std::vector<Interned::value_type> members{ { "y", 1 }, { "x", 2 }, { "y", 3 } };
+    auto object = Interned::from_members(std::move(members));
+    ASSERT_EQ(object.size(), 2u);
+    EXPECT_EQ(object.begin()->first.view(), "x");
+    EXPECT_EQ(object.at("y"), 3);
+}
+
+TEST(FlatObject, ParsedObjectsAreSortedLikeTheMapBackend) {
+    auto node = parser(R"({"z":1,"a":{"q":true,"b":null,"q":false},"m":[{"y":1,"x":2}],"a2":"s","z":2})");
+    ASSERT_TRUE(node.has_value());
+    EXPECT_EQ(generate(*node), R"({"a":{"b":null,"q":false},"a2":"s","m":[{"x":2,"y":1}],"z":2})");
+}
+
+TEST(FlatObject, LargeUnsortedObjectThroughEveryBuilder) {
+    const int n = 5000;
+    std::string text = unsorted_object(n);
+    auto node = parser(text);
+    ASSERT_TRUE(node.has_value());
+    auto& object = std::get<Object>(node->value);
+    ASSERT_EQ(object.size(), size_t(n));
+    for (int i = 0; i < n; i++)
+        ASSERT_EQ(std::get<Int>(object.at("k" + std::to_string(i)).value), n - 1 - i);
+    EXPECT_TRUE(std::is_sorted(object.begin(), object.end(), [](auto& a, auto& b) { return a.first < b.first; }));
+
+    auto doc = parse_document(text);
+    ASSERT_TRUE(doc.has_value());
+    EXPECT_EQ(generate(doc->root.to_node()), generate(*node));
+}
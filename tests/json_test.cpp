@@ -0,0 +1,325 @@
+#include "json.h"
+#include <gtest/gtest.h>
+#include <cmath>
+
+using namespace json;
+
+namespace {
+
+    Float parse_float(const std::string& text) {
+        auto node = parser(text);
+        EXPECT_TRUE(node.has_value()) << text;
+        EXPECT_TRUE(std::holds_alternative<Float>(node->value)) << text;
+        return std::get<Float>(node->value);
+    }
+
+    std::string zeros(size_t n) { return std::string(n, '0'); }
+
+    // 几种解析路径互相对照用的输入: 转义,空容器,嵌套,各种数字,以及跨过64字节块边界的字符串
+    std::vector<std::string> samples() {
+        std::vector<std::string> out = {
+            R"({"a":1,"b":[true,false,null],"c":{"d":"e"}})",
+            R"([1,-2,3.5,-0.25e-3,1E+20,9223372036854775807,-9223372036854775808,18446744073709551616])",
+            R"({"esc":"q\"uote \\ back\\\"slash \/ \b\f\n\r\t \u00e9 \ud83d\ude00","empty":"","arr":[],"obj":{}})",
+            R"( [ { "k" : [ [ ] , { } , "v" ] } , 0 , "" ] )",
+            "\"just a string\"",
+            "42",
+            "null",
+        };
+        std::string big = "{";
+        for (int i = 0; i < 200; i++) {
+            big += "\"key" + std::to_string(i) + "\":";
+            big += i % 3 == 0 ? "\"" + std::string(size_t(i % 70), 'x') + "\\\"" + "\"" : i % 3 == 1 ? std::to_string(i * 1.5) : "[" + std::to_string(i) + ",{\"n\":null}]";
+            big += ",";
+        }
+        big.back() = '}';
+        out.push_back(big);
+        for (size_t shift = 55; shift < 70; shift++)  // 让转义的引号和反斜杠落在块边界的两边
+            out.push_back(std::string(shift, ' ') + R"(["\\","\"",{"\\\"":"a\\"}])");
+        return out;
+    }
+
+    std::optional<Node> push_parse(const std::vector<std::string_view>& chunks) {
+        DomBuilder builder;
+        PushParser<DomBuilder> p{ builder };
+        for (auto chunk : chunks)
+            if (p.feed(chunk) == push_status::error)
+                return {};
+        if (p.finish() != push_status::done)
+            return {};
+        return std::move(builder.result);
+    }
+
+    // 同一个文档的三种表示逐个节点对照: Node(DOM),LazyValue(按需解析),ArenaNode(arena DOM)
+    void expect_same(const Node& node, const LazyValue& lazy, const ArenaNode& arena, const std::string& path) {
+        SCOPED_TRACE(path);
+        std::visit([&](const auto& v) {
+            using V = std::decay_t<decltype(v)>;
+            if constexpr (std::is_same_v<V, Null>) {
+                EXPECT_TRUE(lazy.is_null());
+                EXPECT_TRUE(arena.is_null());
+            }
+            else if constexpr (std::is_same_v<V, Bool>) {
+                EXPECT_EQ(lazy.as_bool(), v);
+                EXPECT_EQ(arena.as_bool(), v);
+            }
+            else if constexpr (std::is_same_v<V, Int>) {
+                EXPECT_EQ(lazy.as_int(), v);
+                EXPECT_EQ(arena.as_int(), v);
+            }
+            else if constexpr (std::is_same_v<V, Float>) {
+                EXPECT_EQ(lazy.type(), Type::Float);
+                EXPECT_EQ(lazy.as_float(), v);
+                EXPECT_EQ(arena.as_float(), v);
+            }
+            else if constexpr (std::is_same_v<V, String>) {
+                EXPECT_EQ(lazy.as_string(), v);
+                EXPECT_EQ(arena.as_string(), v);
+            }
+            else if constexpr (std::is_same_v<V, Array>) {
+                ASSERT_EQ(lazy.size(), v.size());
+                ASSERT_EQ(arena.size(), v.size());
+                for (size_t i = 0; i < v.size(); i++)
+                    expect_same(v[i], lazy[i], arena[i], path + "/" + std::to_string(i));
+            }
+            else {
+                ASSERT_EQ(lazy.size(), v.size());
+                ASSERT_EQ(arena.size(), v.size());
+                for (const auto& [key, child] : v)
+                    expect_same(child, lazy[key], arena[key], path + "/" + std::string{ key });
+            }
+        }, node.value);
+    }
+
+}
+
+TEST(JsonParserFloat, HugeLiteralsOverflowToInfinity) {
+    EXPECT_EQ(parse_float("1e400"), std::numeric_limits<Float>::infinity());
+    EXPECT_EQ(parse_float("-1e400"), -std::numeric_limits<Float>::infinity());
+    EXPECT_EQ(parse_float("1" + zeros(400)), std::numeric_limits<Float>::infinity());  // 没有指数
+    EXPECT_EQ(parse_float("1" + zeros(400) + ".5"), std::numeric_limits<Float>::infinity());
+    EXPECT_EQ(parse_float("0.001e400"), std::numeric_limits<Float>::infinity());
+    EXPECT_EQ(parse_float("1" + zeros(400) + "e-50"), std::numeric_limits<Float>::infinity());  // 指数是负的,数仍然很大
+}
+
+TEST(JsonParserFloat, TinyLiteralsUnderflowToZero) {
+    Float v = parse_float("1e-400");
+    EXPECT_EQ(v, 0.0);
+    EXPECT_FALSE(std::signbit(v));
+
+    v = parse_float("0." + zeros(400) + "1");  // 没有指数
+    EXPECT_EQ(v, 0.0);
+    EXPECT_FALSE(std::signbit(v));
+
+    v = parse_float("-0." + zeros(400) + "1");
+    EXPECT_EQ(v, 0.0);
+    EXPECT_TRUE(std::signbit(v));
+
+    EXPECT_EQ(parse_float("0." + zeros(200) + "1e-200"), 0.0);
+    EXPECT_EQ(parse_float("1000e-500"), 0.0);  // 指数是负的,但整数部分不止一位
+}
+
+TEST(JsonParserFloat, InRangeExtremesAreExact) {
+    EXPECT_EQ(parse_float("1e-310"), 1e-310);  // 非规格化数不算下溢
+    EXPECT_EQ(parse_float("1.7976931348623157e308"), std::numeric_limits<Float>::max());
+    EXPECT_EQ(parse_float("0." + zeros(300) + "1"), 1e-301);
+}
+
+TEST(JsonParserFloat, OutOfRangeValuesInsideDocuments) {
+    auto node = parser("[1e400, 0." + zeros(400) + "1, -1" + zeros(400) + "]");
+    ASSERT_TRUE(node.has_value());
+    const auto& array = std::get<Array>(node->value);
+    ASSERT_EQ(array.size(), 3u);
+    EXPECT_EQ(std::get<Float>(array[0].value), std::numeric_limits<Float>::infinity());
+    EXPECT_EQ(std::get<Float>(array[1].value), 0.0);
+    EXPECT_EQ(std::get<Float>(array[2].value), -std::numeric_limits<Float>::infinity());
+}
+
+TEST(ArenaDocument, DuplicateKeysKeepTheLastValue) {
+    auto doc = parse_document(R"({"a":1,"b":[true],"a":2,"c":{"x":1,"x":null}})");
+    ASSERT_TRUE(doc.has_value());
+    EXPECT_EQ(doc->root.size(), 3u);
+    EXPECT_EQ(doc->root["a"].as_int(), 2);
+    EXPECT_TRUE(doc->root["c"]["x"].is_null());
+    EXPECT_EQ(generate(doc->root), R"({"b":[true],"a":2,"c":{"x":null}})");  // 被覆盖的成员不再输出
+    EXPECT_EQ(generate(doc->root.to_node()), generate(parser(R"({"a":1,"b":[true],"a":2,"c":{"x":1,"x":null}})").value()));
+}
+
+TEST(ArenaDocument, DuplicateKeysInLargeObjects) {
+    std::string text = "{";
+    for (int i = 0; i < 40; i++)
+        text += "\"k" + std::to_string(i % 20) + "\":" + std::to_string(i) + ",";
+    text.back() = '}';
+    auto doc = parse_document(text);
+    ASSERT_TRUE(doc.has_value());
+    ASSERT_EQ(doc->root.size(), 20u);
+    for (int i = 0; i < 20; i++)
+        EXPECT_EQ(doc->root["k" + std::to_string(i)].as_int(), i + 20);
+    EXPECT_EQ(generate(doc->root.to_node()), generate(parser(text).value()));
+}
+
+TEST(StructuralIndex, EverySimdLevelMatchesTheScalarScan) {
+    std::vector<simd_level> levels{ best_simd_level() };
+#if defined(JSON_SIMD_X86)
+    levels.push_back(simd_level::sse2);
+#endif
+    for (const auto& text : samples()) {
+        auto expected = build_structural_index(text, simd_level::scalar);
+        ASSERT_TRUE(expected) << text;
+        for (auto level : levels) {
+            auto index = build_structural_index(text, level);
+            ASSERT_TRUE(index);
+            ASSERT_EQ(index->count, expected->count) << text;
+            EXPECT_TRUE(std::equal(index->positions.get(), index->positions.get() + index->count, expected->positions.get())) << text;
+            EXPECT_FALSE(index->unclosed_string);
+        }
+    }
+    EXPECT_TRUE(build_structural_index(R"(["open)")->unclosed_string);
+}
+
+TEST(StructuralIndex, IndexedParseMatchesByteByByteParse) {
+    for (const auto& text : samples()) {
+        JsonParser plain{ text };  // 没有索引: 逐字节扫描
+        auto expected = plain.parse();
+        ASSERT_TRUE(expected.has_value()) << text;
+        auto indexed = parser(text);
+        ASSERT_TRUE(indexed.has_value()) << text;
+        EXPECT_EQ(generate(*indexed), generate(*expected)) << text;
+    }
+}
+
+TEST(PushParser, EverySplitPointGivesTheSameTree) {
+    for (const auto& text : samples()) {
+        std::string_view all{ text };
+        std::string expected = generate(parser(text).value());
+        for (size_t cut = 0; cut <= all.size(); cut++) {  // 两块,截断位置覆盖每一个字节
+            auto node = push_parse({ all.substr(0, cut), all.substr(cut) });
+            ASSERT_TRUE(node.has_value()) << "cut at " << cut << ": " << text;
+            ASSERT_EQ(generate(*node), expected) << "cut at " << cut;
+        }
+        std::vector<std::string_view> bytes;  // 每次只喂一个字节: 转义序列,数字,字面量都被拆开
+        for (size_t i = 0; i < all.size(); i++)
+            bytes.push_back(all.substr(i, 1));
+        auto node = push_parse(bytes);
+        ASSERT_TRUE(node.has_value()) << text;
+        EXPECT_EQ(generate(*node), expected);
+    }
+}
+
+TEST(PushParser, TopLevelNumberEndsAtFinish) {
+    DomBuilder builder;
+    PushParser<DomBuilder> p{ builder };
+    EXPECT_EQ(p.feed("12"), push_status::need_more);
+    EXPECT_EQ(p.feed("34"), push_status::need_more);  // 还不知道数字有没有结束
+    EXPECT_EQ(p.finish(), push_status::done);
+    EXPECT_EQ(std::get<Int>(builder.result->value), 1234);
+}
+
+TEST(PushParser, RejectsMalformedInputAtAnyChunking) {
+    for (std::string_view bad : { "[1,]", "{\"a\" 1}", "{\"a\":1,}", "[1 2]", "1 2", "[\"unterminated", "{1:2}", "tru", "[nul]", "]" }) {
+        EXPECT_FALSE(push_parse({ bad }).has_value()) << bad;
+        std::vector<std::string_view> bytes;
+        for (size_t i = 0; i < bad.size(); i++)
+            bytes.push_back(bad.substr(i, 1));
+        EXPECT_FALSE(push_parse(bytes).has_value()) << bad;
+    }
+}
+
+TEST(PushParser, ResetParsesAnotherDocument) {
+    DomBuilder builder;
+    PushParser<DomBuilder> p{ builder };
+    EXPECT_EQ(p.feed("[1,"), push_status::need_more);
+    EXPECT_EQ(p.feed("2]"), push_status::done);
+    p.reset();
+    builder = DomBuilder{};
+    EXPECT_EQ(p.feed("{\"k\":\"v\"}"), push_status::done);
+    EXPECT_EQ(generate(*builder.result), R"({"k":"v"})");
+}
+
+TEST(LazyDocument, AgreesWithDomAndArenaOnEveryNode) {
+    for (const auto& text : samples()) {
+        auto node = parser(text);
+        auto lazy = parse_lazy(text);
+        auto doc = parse_document(text);
+        ASSERT_TRUE(node && lazy && doc) << text;
+        expect_same(*node, lazy->root(), doc->root, "");
+        EXPECT_EQ(generate(lazy->root().to_node()), generate(*node));
+        EXPECT_EQ(generate(doc->root.to_node()), generate(*node));
+    }
+}
+
+TEST(LazyDocument, SkipsUnvisitedSubtreesAndReportsErrorsLazily) {
+    std::string text = R"({"skip":[{"x":[1,2,{"y":"}]"}]},"[{"],"bad":[1,tru],"want":{"k":"v"}})";
+    auto lazy = parse_lazy(text);
+    ASSERT_TRUE(lazy.has_value());
+    EXPECT_EQ(lazy->root()["want"]["k"].as_string(), "v");  // 括号计数跳过前面的子树,包括字符串里的括号
+    EXPECT_EQ(lazy->root()["skip"][1].as_string(), "[{");
+    EXPECT_EQ(lazy->root()["want"].raw(), R"({"k":"v"})");
+    EXPECT_FALSE(lazy->root().find("missing").has_value());
+    EXPECT_EQ(lazy->root()["bad"][0].as_int(), 1);
+    EXPECT_THROW(lazy->root()["bad"][1].as_bool(), std::runtime_error);  // 只有真正读到出错的值时才发现
+    EXPECT_FALSE(parse_lazy(R"({"a":"unterminated)").has_value());
+}
+
+namespace reflect_test {  // JSON_REFLECT要写在结构体所在的命名空间里
+
+    struct Point {
+        double x = 0;
+        double y = 0;
+        std::vector<std::string> tags;
+    };
+    JSON_REFLECT(Point, x, y, tags)
+
+    struct Shape {
+        std::string name;
+        std::int8_t layer = -1;
+        std::optional<Point> center;
+        std::vector<Point> outline;
+        std::map<std::string, int> counts;
+        Node extra;
+        bool visible = true;
+    };
+    JSON_REFLECT(Shape, name, layer, center, outline, counts, extra, visible)
+
+}
+
+TEST(Reflect, RoundTripsThroughGenerate) {
+    using namespace reflect_test;
+    Shape s;
+    s.name = "tri \"1\"";
+    s.layer = 3;
+    s.center = Point{ 0.5, -1, { "c" } };
+    s.outline = { { 0, 0, {} }, { 1, 0, { "a", "b" } } };
+    s.counts = { { "k", 7 } };
+    s.extra = parser(R"({"any":[1,"thing"]})").value();
+    s.visible = false;
+    auto text = generate(s);
+    auto back = parse_as<Shape>(text);
+    ASSERT_TRUE(back.has_value()) << text;
+    EXPECT_EQ(generate(*back), text);
+    EXPECT_EQ(back->name, s.name);
+    EXPECT_EQ(back->outline[1].tags, s.outline[1].tags);
+    EXPECT_EQ(generate(back->extra), R"({"any":[1,"thing"]})");
+}
+
+TEST(Reflect, MissingFieldsKeepDefaultsAndUnknownKeysAreSkipped) {
+    using namespace reflect_test;
+    auto s = parse_as<Shape>(R"({"unknown":{"deep":[1,{"x":2}]},"name":"n","center":null,"na\u006de":"escaped key"})");
+    ASSERT_TRUE(s.has_value());
+    EXPECT_EQ(s->name, "escaped key");  // 转义过的key也能找到字段,重复的key以最后一个为准
+    EXPECT_EQ(s->layer, -1);
+    EXPECT_FALSE(s->center.has_value());
+    EXPECT_TRUE(s->visible);
+    EXPECT_TRUE(s->extra.value.index() == 0);
+}
+
+TEST(Reflect, TypeMismatchesFail) {
+    using namespace reflect_test;
+    EXPECT_FALSE(parse_as<Shape>(R"({"name":1})").has_value());
+    EXPECT_FALSE(parse_as<Shape>(R"({"layer":300})").has_value());  // 超出int8_t
+    EXPECT_FALSE(parse_as<Shape>(R"({"layer":1.5})").has_value());
+    EXPECT_FALSE(parse_as<Shape>(R"({"outline":{}})").has_value());
+    EXPECT_FALSE(parse_as<Shape>(R"({"center":{"x":"1"}})").has_value());
+    EXPECT_FALSE(parse_as<Point>(R"([1,2])").has_value());
+    EXPECT_TRUE(parse_as<Point>(R"({"x":1,"y":2})").has_value());  // 整数可以读进浮点字段
+}
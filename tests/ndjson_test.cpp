@@ -0,0 +1,103 @@
+#include "ndjson.h"
+#include <gtest/gtest.h>
+
+using namespace json;
+
+namespace {
+
+    struct ndjson_input {
+        std::string text;
+        std::vector<std::string> good;  // 按顺序解析成功的行
+        std::vector<size_t> bad;  // 解析失败的行号
+    };
+
+    ndjson_input make_input(size_t lines) {
+        ndjson_input in;
+        for (size_t i = 0; i < lines; i++) {
+            std::string line;
+            switch (i % 7) {
+                case 0: line = R"({"id":)" + std::to_string(i) + R"(,"tags":["a","b\"c"],"ok":true})"; break;
+                case 1: line = "[" + std::to_string(i) + ",1.5,null,{}]"; break;
+                case 2: line = "   "; break;  // 空行(只有空白)跳过,但占行号
+                case 3: line = R"({"broken":)"; break;
+                case 4: line = R"({"s":"é\n","n":-)" + std::to_string(i) + "}\r"; break;  // Windows换行
+                case 5: line = "\"" + std::string(i % 100, 'x') + "\""; break;
+                default: line = "[1] trailing"; break;  // 一行里只能有一个文档
+            }
+            in.text += line + "\n";
+            if (i % 7 == 3 || i % 7 == 6)
+                in.bad.push_back(i);
+            else if (i % 7 != 2)
+                in.good.push_back(generate(parser(line).value()));
+        }
+        return in;
+    }
+
+    void expect_serial_result(const ndjson_input& in, const std::vector<NdjsonBatch>& batches) {
+        std::vector<std::string> docs;
+        std::vector<size_t> bad;
+        size_t next_line = 0;
+        for (auto& batch : batches) {
+            EXPECT_EQ(batch.first_line, next_line);
+            next_line += batch.num_lines;
+            for (auto& doc : batch.docs)
+                docs.push_back(generate(doc.to_node()));
+            bad.insert(bad.end(), batch.bad_lines.begin(), batch.bad_lines.end());
+        }
+        EXPECT_EQ(docs, in.good);
+        EXPECT_EQ(bad, in.bad);
+    }
+
+}
+
+TEST(Ndjson, ParallelParseMatchesLineByLineParse) {
+    ThreadPool<> pool(4);
+    auto in = make_input(2000);
+    for (size_t chunk_size : { size_t(1), size_t(100), size_t(4096), size_t(1) << 20 }) {
+        for (bool zero_copy : { true, false }) {
+            ndjson_options opt;
+            opt.chunk_size = chunk_size;
+            opt.max_in_flight = 3;
+            opt.parse.zero_copy = zero_copy;
+            auto batches = parse_ndjson(pool, in.text, opt);
+            SCOPED_TRACE("chunk_size " + std::to_string(chunk_size));
+            expect_serial_result(in, batches);
+        }
+    }
+}
+
+TEST(Ndjson, LastLineWithoutNewline) {
+    ThreadPool<> pool(2);
+    auto batches = parse_ndjson(pool, "1\n\n[2]");
+    size_t docs = 0;
+    for (auto& b : batches)
+        docs += b.docs.size();
+    EXPECT_EQ(docs, 2u);
+}
+
+TEST(Ndjson, CallbackExceptionPropagatesAfterInFlightChunksFinish) {
+    ThreadPool<> pool(2);
+    auto in = make_input(500);
+    ndjson_options opt;
+    opt.chunk_size = 64;
+    size_t seen = 0;
+    EXPECT_THROW(for_each_ndjson(pool, in.text, [&](NdjsonBatch&&) {
+        if (++seen == 3)
+            throw std::runtime_error("stop");
+    }, opt), std::runtime_error);
+    EXPECT_EQ(seen, 3u);
+}
+
+TEST(Ndjson, RejectedChunkPropagatesAfterInFlightChunksFinish) {
+    pool_options o;
+    o.capacity = 1;
+    o.on_full = overflow_policy::reject;
+    ThreadPool<> pool(2, o);
+    auto in = std::make_unique<std::string>(make_input(20000).text);
+    ndjson_options opt;
+    opt.chunk_size = 1024;
+    opt.max_in_flight = 8;
+    EXPECT_THROW(parse_ndjson(pool, *in, opt), queue_full);  // 不能变成对已经取过结果的future再wait的future_error
+    in.reset();  // 返回之后没有块还在读input
+    EXPECT_EQ(pool.stats().pending, 0u);
+}
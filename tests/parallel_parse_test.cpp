@@ -0,0 +1,87 @@
+#include "parallel_parse.h"
+#include <gtest/gtest.h>
+
+using namespace json;
+
+namespace {
+
+    // 顶层数组的元素里故意放进深层的逗号,字符串里的逗号/括号/转义引号,让错误的切分点一定会被发现
+    std::string make_array(size_t n) {
+        std::string text = "[";
+        for (size_t i = 0; i < n; i++) {
+            switch (i % 6) {
+                case 0: text += std::to_string(i); break;
+                case 1: text += R"("a,b],[c\",)" + std::to_string(i) + "\""; break;
+                case 2: text += "[[" + std::to_string(i) + ",2],{\"x\":[3,4]},[]]"; break;
+                case 3: text += R"({"id":)" + std::to_string(i) + R"(,"s":"}{,","f":-1.25e-3,"n":null})"; break;
+                case 4: text += " \n\t\"" + std::string(i % 80, 'x') + "\" "; break;
+                default: text += "true"; break;
+            }
+            text += i + 1 < n ? "," : "";
+        }
+        return text + "]";
+    }
+
+    void expect_serial_result(ThreadPool<>& pool, const std::string& text, const parallel_parse_options& opt) {
+        SCOPED_TRACE(text.substr(0, 80));
+        auto serial = parser(text);
+        auto node = parser_parallel(pool, text, opt);
+        ASSERT_EQ(node.has_value(), serial.has_value());
+        auto doc = parse_document_parallel(pool, text, opt);
+        ASSERT_EQ(doc.has_value(), serial.has_value());
+        if (serial) {
+            auto expected = generate(*serial);
+            EXPECT_EQ(generate(*node), expected);
+            EXPECT_EQ(generate(doc->root.to_node()), expected);
+        }
+    }
+
+}
+
+TEST(ParallelParse, SplitsOnlyBetweenTopLevelElements) {
+    auto text = make_array(3000);
+    auto index = build_structural_index(text);
+    ASSERT_TRUE(index);
+    std::vector<ArraySegment> segments;
+    ASSERT_TRUE(split_top_level_array(text, *index, 1000, segments));
+    ASSERT_GT(segments.size(), 10u);
+    EXPECT_EQ(segments.front().first, 1u);
+    for (size_t i = 0; i < segments.size(); i++) {
+        char end = text[index->positions[segments[i].last]];
+        EXPECT_EQ(end, i + 1 < segments.size() ? ',' : ']');
+        if (i > 0) {
+            EXPECT_EQ(segments[i].first, segments[i - 1].last + 1);
+        }
+    }
+    EXPECT_FALSE(split_top_level_array(R"({"a":[1,2]})", *build_structural_index(R"({"a":[1,2]})"), 1, segments));
+    EXPECT_FALSE(split_top_level_array("[1,2", *build_structural_index("[1,2"), 1, segments));
+}
+
+TEST(ParallelParse, HugeArrayMatchesSerialParse) {
+    ThreadPool<> pool(4);
+    auto text = make_array(20000);
+    for (size_t min_segment_size : { size_t(1), size_t(4096), size_t(1) << 30 }) {  // 每个逗号都切,正常切,不切
+        for (bool zero_copy : { true, false }) {
+            parallel_parse_options opt;
+            opt.min_segment_size = min_segment_size;
+            opt.max_segments = min_segment_size == 1 ? 1000 : 0;
+            opt.parse.zero_copy = zero_copy;
+            expect_serial_result(pool, text, opt);
+        }
+    }
+}
+
+TEST(ParallelParse, FallbacksAndErrorsMatchSerialParse) {
+    ThreadPool<> pool(4);
+    parallel_parse_options opt;
+    opt.min_segment_size = 8;
+    auto big = make_array(200);
+    std::string broken = big;
+    broken.insert(broken.size() / 2, ",,");  // 错误在中间某一段里
+    for (const std::string& text : { std::string("[]"), std::string("[1,2,3,4,5,6,7,8,9,10,11,12,13,14,]"),
+                                     std::string("[1,2,3,4,5,6,7,8,9,10,11,12,13,14] x"),
+                                     std::string(R"({"not":"an array","pad":[1,2,3,4,5,6,7,8,9]})"),
+                                     std::string("[1,2,3,4,5,6,7,8,9,10,11,12,13,14"),
+                                     std::string(R"(   "a string long enough to split")"), broken })
+        expect_serial_result(pool, text, opt);
+}
@@ -0,0 +1,73 @@
+#include "pointer.h"
+#include <gtest/gtest.h>
+
+using namespace json;
+
+namespace {
+
+    // RFC 6901第5节的例子,再加上几个~0/~1的组合和数字key
+    const std::string document = R"({"foo":["bar","baz"],"":0,"a/b":1,"c%d":2,"e^f":3,"g|h":4,"i\\j":5,"k\"l":6," ":7,"m~n":8,)"
+                                 R"("~1":9,"/0":10,"~":11,"obj":{"0":"zero","01":"leading zero","-":"dash"}})";
+
+    // 同一个pointer分别查Node, ArenaNode和LazyValue,三种结果必须一样; 没找到时返回nullopt
+    std::optional<std::string> lookup(std::string_view text) {
+        auto ptr = JsonPointer::compile(text);
+        if (!ptr) {
+            ADD_FAILURE() << "invalid pointer " << text;
+            return {};
+        }
+        auto node = parser(document).value();
+        auto doc = parse_document(document).value();
+        auto lazy = parse_lazy(document).value();
+        auto from_node = ptr->find(node);
+        auto from_arena = ptr->find(doc.root);
+        auto from_lazy = ptr->find(lazy);
+        EXPECT_EQ(from_node != nullptr, from_arena != nullptr) << text;
+        EXPECT_EQ(from_node != nullptr, from_lazy.has_value()) << text;
+        if (!from_node || !from_arena || !from_lazy)
+            return {};
+        auto out = generate(*from_node);
+        EXPECT_EQ(generate(from_arena->to_node()), out) << text;
+        EXPECT_EQ(generate(from_lazy->to_node()), out) << text;
+        return out;
+    }
+
+}
+
+TEST(JsonPointer, Rfc6901Examples) {
+    EXPECT_EQ(lookup(""), generate(parser(document).value()));
+    EXPECT_EQ(lookup("/foo"), R"(["bar","baz"])");
+    EXPECT_EQ(lookup("/foo/0"), R"("bar")");
+    EXPECT_EQ(lookup("/"), "0");
+    EXPECT_EQ(lookup("/a~1b"), "1");
+    EXPECT_EQ(lookup("/c%d"), "2");
+    EXPECT_EQ(lookup("/e^f"), "3");
+    EXPECT_EQ(lookup("/g|h"), "4");
+    EXPECT_EQ(lookup("/i\\j"), "5");
+    EXPECT_EQ(lookup("/k\"l"), "6");
+    EXPECT_EQ(lookup("/ "), "7");
+    EXPECT_EQ(lookup("/m~0n"), "8");
+}
+
+TEST(JsonPointer, EscapesAreDecodedOnceLeftToRight) {
+    EXPECT_EQ(JsonPointer::compile("/~01")->steps()[0].key, "~1");  // 先还原~0得到的~不会再和后面的1组成~1
+    EXPECT_EQ(lookup("/~01"), "9");
+    EXPECT_EQ(lookup("/~10"), "10");
+    EXPECT_EQ(lookup("/~0"), "11");
+    EXPECT_EQ(lookup("/a/b"), std::nullopt);  // 没转义的/是分隔符
+    for (auto bad : { "foo", "/~", "/~2", "/a~", "/m~n", "/foo/~x" })
+        EXPECT_FALSE(JsonPointer::compile(bad).has_value()) << bad;
+}
+
+TEST(JsonPointer, ArrayIndicesAndMissingPaths) {
+    EXPECT_EQ(lookup("/foo/1"), R"("baz")");
+    EXPECT_EQ(lookup("/foo/2"), std::nullopt);   // 越界
+    EXPECT_EQ(lookup("/foo/01"), std::nullopt);  // 以0开头的不是下标
+    EXPECT_EQ(lookup("/foo/-"), std::nullopt);
+    EXPECT_EQ(lookup("/foo/0/x"), std::nullopt);  // 中途遇到的是字符串
+    EXPECT_EQ(lookup("/missing"), std::nullopt);
+    EXPECT_EQ(lookup("/obj/0"), R"("zero")");     // 对象里数字形式的token就是普通的key
+    EXPECT_EQ(lookup("/obj/01"), R"("leading zero")");
+    EXPECT_EQ(lookup("/obj/-"), R"("dash")");
+    EXPECT_EQ(JsonPointer::compile("/foo/18446744073709551616")->steps()[1].index, JsonPointer::npos);
+}
@@ -0,0 +1,82 @@
+#include "shared_node.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace json;
+
+namespace {
+
+    SharedNode sample() {  // {"a": {"b": [1, 2, 3]}, "s": "x"}
+        SharedNode s{ SharedObject{} };
+        s["a"] = SharedObject{};
+        s["a"]["b"] = SharedArray{ 1, 2, 3 };
+        s["s"] = "x";
+        return s;
+    }
+
+}
+
+TEST(SharedNodeIndex, LiteralZeroIsAnArrayIndex) {
+    SharedNode s = sample();
+    EXPECT_EQ(s["a"]["b"][0].as_int(), 1);
+    s["a"]["b"][0] = 10;
+    EXPECT_EQ(s["a"]["b"][0].as_int(), 10);
+
+    const SharedNode& c = s;
+    EXPECT_EQ(c["a"]["b"][0].as_int(), 10);
+    EXPECT_EQ(c["a"]["b"][2].as_int(), 3);
+}
+
+TEST(SharedNodeIndex, StringLikeKeys) {
+    SharedNode s = sample();
+    std::string key = "k";
+    std::string_view view = "v";
+    const char* pointer = "p";
+    s[key] = 1;
+    s[view] = 2;
+    s[pointer] = 3;
+    s[std::string{ "m" }] = 4;
+    EXPECT_EQ(key, "k");  // 左值的string不会被移动
+    EXPECT_EQ(s.size(), 6u);
+
+    const SharedNode& c = s;
+    EXPECT_EQ(c[key].as_int(), 1);
+    EXPECT_EQ(c[view].as_int(), 2);
+    EXPECT_EQ(c[pointer].as_int(), 3);
+    EXPECT_EQ(c["m"].as_int(), 4);
+    EXPECT_THROW(c["missing"], std::out_of_range);
+    EXPECT_EQ(s.size(), 6u);  // const的operator[]不插入
+}
+
+TEST(SharedNodeIndex, WritesThroughIndexCopyOnlyTheSharedPath) {
+    SharedNode s = sample();
+    SharedNode copy = s;
+    s["a"]["b"][0] = 10;
+    EXPECT_EQ(copy["a"]["b"][0].as_int(), 1);
+    EXPECT_TRUE(std::as_const(s)["s"].shares(std::as_const(copy)["s"]));  // 没碰到的成员继续共享
+}
+
+TEST(SharedNodeThreads, EachThreadModifiesItsOwnCopy) {
+    SharedNode original = sample();
+    std::vector<std::thread> threads;
+    std::vector<SharedNode> results(8);
+    for (size_t t = 0; t < results.size(); t++) {
+        threads.emplace_back([&, t, copy = original]() mutable {  // 每个线程拿一个副本,读写都不加锁
+            for (int i = 0; i < 1000; i++) {
+                copy["a"]["b"].push(int(t));
+                SharedNode snapshot = copy;  // 有snapshot时修改要复制路径; 它在本轮末尾析构,下一轮copy又是独占的,原地修改
+                copy["a"]["b"][0] = i;
+            }
+            results[t] = std::move(copy);
+        });
+    }
+    for (auto& th : threads)
+        th.join();
+    EXPECT_EQ(generate(original), R"({"a":{"b":[1,2,3]},"s":"x"})");
+    for (size_t t = 0; t < results.size(); t++) {
+        EXPECT_EQ(results[t]["a"]["b"].size(), 1003u);
+        EXPECT_EQ(results[t]["a"]["b"][0].as_int(), 999);
+        EXPECT_EQ(results[t]["a"]["b"][1002].as_int(), Int(t));
+        EXPECT_TRUE(std::as_const(results[t])["s"].shares(std::as_const(original)["s"]));
+    }
+}
@@ -0,0 +1,507 @@
+#include "threadpool.h"
+#include <gtest/gtest.h>
+#include <numeric>
+
+namespace {
+
+    // 在deadline之前等到pred成立; 用来给"只有某个机制生效才会发生"的事情设一个上限,而不是卡死整个测试
+    template<typename Pred>
+    bool eventually(Pred pred, std::chrono::seconds limit = std::chrono::seconds(10)) {
+        auto deadline = std::chrono::steady_clock::now() + limit;
+        while (!pred()) {
+            if (std::chrono::steady_clock::now() > deadline)
+                return false;
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    struct blocked_worker {  // 让唯一的worker停在一个任务里,这期间提交的任务都排在队列里
+        std::atomic<bool> started{ false };
+        std::atomic<bool> release{ false };
+        std::atomic<bool> done{ false };
+        template<typename Pool>
+        explicit blocked_worker(Pool& pool) {
+            pool.post([this] {
+                started.store(true);
+                while (!release.load())
+                    std::this_thread::yield();
+                done.store(true);  // 之后不再访问this
+            });
+            while (!started.load())
+                std::this_thread::yield();
+        }
+        ~blocked_worker() {  // 等blocker真正退出再让这些标志离开作用域,否则它还在读release
+            release.store(true);
+            while (!done.load())
+                std::this_thread::yield();
+        }
+    };
+
+    pool_options bounded(overflow_policy on_full) {  // 容量1: blocked_worker占住worker之后,再提交一个就满了
+        pool_options o;
+        o.capacity = 1;
+        o.on_full = on_full;
+        return o;
+    }
+
+}
+
+TEST(WorkStealingQueue, OwnerPopsNewestThiefStealsOldest) {
+    work_stealing_queue<int> q;
+    for (int i = 1; i <= 3; i++)
+        q.push(i);
+    int v = 0;
+    ASSERT_TRUE(q.pop(v));
+    EXPECT_EQ(v, 3);
+    ASSERT_TRUE(q.steal(v));
+    EXPECT_EQ(v, 1);
+    ASSERT_TRUE(q.pop(v));
+    EXPECT_EQ(v, 2);
+    EXPECT_FALSE(q.pop(v));
+    EXPECT_FALSE(q.steal(v));
+}
+
+TEST(WorkStealing, IdleWorkerStealsFromABusyWorkersLocalQueue) {
+    pool_options opt;
+    opt.work_stealing = true;
+    opt.metrics = true;
+    ThreadPool<> pool(2, opt);
+    constexpr int children = 64;
+    std::atomic<int> done{ 0 };
+    // 父任务在worker上提交的子任务进它自己的本地队列,然后父任务一直占着这个worker: 子任务只能被另一个worker偷走执行
+    auto parent = pool.submit([&] {
+        for (int i = 0; i < children; i++)
+            pool.post([&done] { done.fetch_add(1); });
+        return eventually([&] { return done.load() == children; });
+    });
+    EXPECT_TRUE(parent.get());
+    std::uint64_t stolen = 0;
+    for (auto& w : pool.stats().workers)
+        stolen += w.stolen;
+    EXPECT_EQ(stolen, std::uint64_t(children));
+}
+
+TEST(WorkStealing, NestedSubmitsAllComplete) {
+    pool_options opt;
+    opt.work_stealing = true;
+    ThreadPool<> pool(4, opt);
+    std::atomic<int> leaves{ 0 };
+    std::vector<std::future<void>> futs;
+    for (int i = 0; i < 16; i++)
+        futs.push_back(pool.submit([&] {
+            for (int j = 0; j < 100; j++)
+                pool.post([&leaves] { leaves.fetch_add(1); });
+        }));
+    for (auto& f : futs)
+        f.get();
+    EXPECT_TRUE(eventually([&] { return leaves.load() == 1600; }));
+}
+
+TEST(LockfreeQueue, BoundedFifoLeavesTheValueWhenFull) {
+    lockfree_queue<int, 4> q;
+    for (int i = 0; i < 4; i++) {
+        int v = i;
+        ASSERT_TRUE(q.push(v));
+    }
+    int extra = 42;
+    EXPECT_FALSE(q.push(extra));
+    EXPECT_EQ(extra, 42);
+    EXPECT_EQ(q.size(), 4u);
+    int v = -1;
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(q.pop(v));
+        EXPECT_EQ(v, i);
+    }
+    EXPECT_FALSE(q.pop(v));
+    EXPECT_TRUE(q.push(extra));  // 绕过一圈之后槽可以复用
+    ASSERT_TRUE(q.pop(v));
+    EXPECT_EQ(v, 42);
+}
+
+TEST(LockfreeQueue, ConcurrentProducersAndConsumersSeeEveryItemOnce) {
+    lockfree_queue<int, 64> q;
+    constexpr int producers = 4, consumers = 4, per_producer = 20000;
+    std::vector<std::atomic<int>> seen(producers * per_producer);
+    std::atomic<int> consumed{ 0 };
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++)
+        threads.emplace_back([&, p] {
+            for (int i = 0; i < per_producer; i++) {
+                int v = p * per_producer + i;
+                while (!q.push(v))
+                    std::this_thread::yield();
+            }
+        });
+    for (int c = 0; c < consumers; c++)
+        threads.emplace_back([&] {
+            int v;
+            while (consumed.load() < producers * per_producer) {
+                if (q.pop(v)) {
+                    seen[v].fetch_add(1);
+                    consumed.fetch_add(1);
+                }
+                else
+                    std::this_thread::yield();
+            }
+        });
+    for (auto& t : threads)
+        t.join();
+    for (auto& s : seen)
+        ASSERT_EQ(s.load(), 1);
+}
+
+TEST(LockfreeQueue, PoolRunsMoreTasksThanTheRingHolds) {
+    ThreadPool<lockfree_queue> pool(2);
+    std::atomic<int> ran{ 0 };
+    std::vector<std::future<int>> futs;
+    for (int i = 0; i < 5000; i++)  // 环满了按默认的block策略: 外部线程睡在信号量上等worker取走
+        futs.push_back(pool.submit([&ran](int x) { ran.fetch_add(1); return x * 2; }, i));
+    for (int i = 0; i < 5000; i++)
+        ASSERT_EQ(futs[i].get(), i * 2);
+    EXPECT_EQ(ran.load(), 5000);
+}
+
+TEST(LockfreeQueue, FullRingFollowsTheOverflowPolicy) {
+    constexpr size_t ring = lockfree_queue<task>::capacity;
+    std::atomic<size_t> ran{ 0 };
+    std::vector<std::future<void>> queued;
+    std::future<void> rejected;
+    bool posted = true;
+    std::thread::id overflow_on;
+    {
+        pool_options o = bounded(overflow_policy::reject);
+        o.capacity = 0;  // 无界也按环的大小算
+        ThreadPool<lockfree_queue> rejecting(1, o);
+        o.capacity = ring * 4;
+        o.on_full = overflow_policy::caller_runs;
+        ThreadPool<lockfree_queue> caller_runs(1, o);
+        {
+            blocked_worker b1{ rejecting };
+            blocked_worker b2{ caller_runs };
+            for (size_t i = 0; i < ring; i++) {
+                queued.push_back(rejecting.submit([&ran] { ran.fetch_add(1); }));
+                caller_runs.post([&ran] { ran.fetch_add(1); });
+            }
+            rejected = rejecting.submit([&ran] { ran.fetch_add(1000000); });
+            posted = rejecting.post([&ran] { ran.fetch_add(1000000); });
+            caller_runs.submit([&] { overflow_on = std::this_thread::get_id(); }).get();  // 环满了: 不再让出CPU轮询,直接在这里执行
+        }
+    }
+    EXPECT_THROW(rejected.get(), queue_full);
+    EXPECT_FALSE(posted);
+    EXPECT_EQ(overflow_on, std::this_thread::get_id());
+    EXPECT_EQ(ran.load(), 2 * ring);
+}
+
+TEST(Batches, EveryTaskRunsAndFuturesKeepTheirOrder) {
+    std::atomic<int> ran{ 0 };
+    ThreadPool<> pool(4);
+    for (int i = 0; i < 100; i++)
+        EXPECT_TRUE(pool.post([&ran] { ran.fetch_add(1); }));
+    std::vector<std::function<int()>> fs;
+    for (int i = 0; i < 1000; i++)
+        fs.push_back([&ran, i] { ran.fetch_add(1); return i * 3; });
+    auto futs = pool.submit_bulk(fs);  // 左值range: 拷贝,fs保持不变
+    ASSERT_EQ(futs.size(), fs.size());
+    for (int i = 0; i < 1000; i++)
+        EXPECT_EQ(futs[size_t(i)].get(), i * 3);
+    EXPECT_EQ(fs[7](), 21);  // 这一次在测试线程上执行,也计入ran
+    std::vector<std::function<void()>> posts(1000, [&ran] { ran.fetch_add(1); });
+    EXPECT_EQ(pool.post_batch(std::move(posts)), 1000u);
+    EXPECT_TRUE(eventually([&] { return ran.load() == 100 + 1000 + 1 + 1000; }));
+}
+
+TEST(Batches, RejectedTasksAreReportedPerTask) {
+    std::atomic<int> ran{ 0 };
+    std::vector<std::future<int>> futs;
+    size_t accepted = 0;
+    pool_options o = bounded(overflow_policy::reject);
+    o.capacity = 3;
+    {
+        ThreadPool<> pool(1, o);
+        blocked_worker b{ pool };
+        std::vector<std::function<int()>> fs;
+        for (int i = 0; i < 5; i++)
+            fs.push_back([&ran, i] { ran.fetch_add(1); return i; });
+        futs = pool.submit_bulk(fs);  // 前3个占满空位,后2个拒绝
+        accepted = pool.post_batch(std::vector<std::function<void()>>(4, [&ran] { ran.fetch_add(100); }));
+    }
+    ASSERT_EQ(futs.size(), 5u);
+    for (int i = 0; i < 3; i++)
+        EXPECT_EQ(futs[size_t(i)].get(), i);
+    for (int i = 3; i < 5; i++)
+        EXPECT_THROW(futs[size_t(i)].get(), queue_full);
+    EXPECT_EQ(accepted, 0u);
+    EXPECT_EQ(ran.load(), 3);
+}
+
+TEST(ParallelFor, CoversEveryIndexExactlyOnce) {
+    for (bool stealing : { false, true }) {
+        pool_options o;
+        o.work_stealing = stealing;
+        ThreadPool<> pool(4, o);
+        // 空区间,反过来的区间,比一块还小的区间,自动grain,以及最后一块不满的情况
+        for (auto [begin, end, grain] : { std::array<int, 3>{ 0, 0, 4 }, { 5, 5, 0 }, { 10, 3, 1 }, { 0, 3, 10 }, { -50, 10007, 0 }, { -50, 10007, 1 }, { 0, 10007, 64 } }) {
+            SCOPED_TRACE(std::to_string(begin) + " " + std::to_string(end) + " " + std::to_string(grain) + (stealing ? " stealing" : ""));
+            size_t n = end > begin ? size_t(end - begin) : 0;
+            std::vector<std::atomic<int>> hits(n);
+            pool.parallel_for(begin, end, grain, [&](int i) { hits[size_t(i - begin)].fetch_add(1); });
+            std::vector<std::atomic<int>> block_hits(n);
+            pool.parallel_for(begin, end, grain, [&](int b, int e) {
+                EXPECT_LT(b, e);
+                for (int i = b; i < e; i++)
+                    block_hits[size_t(i - begin)].fetch_add(1);
+            });
+            for (size_t i = 0; i < n; i++) {
+                EXPECT_EQ(hits[i].load(), 1) << i;
+                EXPECT_EQ(block_hits[i].load(), 1) << i;
+            }
+        }
+        EXPECT_THROW(pool.parallel_for(0, 1000, 1, [](int i) {
+            if (i == 537)
+                throw std::runtime_error("body");
+        }), std::runtime_error);
+    }
+}
+
+TEST(ParallelReduce, MatchesASerialLoop) {
+    for (bool stealing : { false, true }) {
+        pool_options o;
+        o.work_stealing = stealing;
+        ThreadPool<> pool(4, o);
+        for (auto [begin, end, grain] : { std::array<std::int64_t, 3>{ 0, 0, 4 }, { 7, 3, 1 }, { 0, 3, 10 }, { -1000, 100000, 0 }, { 0, 100001, 333 } }) {
+            SCOPED_TRACE(std::to_string(begin) + " " + std::to_string(end) + " " + std::to_string(grain) + (stealing ? " stealing" : ""));
+            std::int64_t serial = 0;
+            for (auto i = begin; i < end; i++)
+                serial += i * i;
+            auto plus = [](std::int64_t a, std::int64_t b) { return a + b; };
+            EXPECT_EQ(pool.parallel_reduce(begin, end, grain, std::int64_t(0), [](std::int64_t i) { return i * i; }, plus), serial);
+            EXPECT_EQ(pool.parallel_reduce(begin, end, grain, std::int64_t(0), [](std::int64_t b, std::int64_t e) {
+                std::int64_t s = 0;
+                for (auto i = b; i < e; i++)
+                    s += i * i;
+                return s;
+            }, plus), serial);
+        }
+        EXPECT_EQ(pool.parallel_reduce(5, 5, 1, -7, [](int i) { return i; }, [](int a, int b) { return std::max(a, b); }), -7);  // 空区间原样返回identity
+        std::string serial;  // 不满足交换律的combine: 部分结果必须按块的顺序合并
+        for (int i = 0; i < 500; i++)
+            serial += std::to_string(i) + ",";
+        auto joined = pool.parallel_reduce(0, 500, 7, std::string(), [](int i) { return std::to_string(i) + ","; }, [](std::string a, const std::string& b) { return a + b; });
+        EXPECT_EQ(joined, serial);
+    }
+}
+
+TEST(PriorityLanes, HigherLanesRunFirst) {
+    ThreadPool<> pool(1);
+    std::mutex m;
+    std::string order;
+    std::vector<std::future<void>> futs;
+    {
+        blocked_worker b{ pool };
+        auto record = [&](char c) {
+            std::lock_guard<std::mutex> lc(m);
+            order += c;
+        };
+        futs.push_back(pool.submit(priority::low, record, 'l'));
+        futs.push_back(pool.submit(priority::normal, record, 'n'));
+        futs.push_back(pool.submit(priority::high, record, 'h'));
+        futs.push_back(pool.submit(priority::low, record, 'L'));
+        futs.push_back(pool.submit(priority::high, record, 'H'));
+    }
+    for (auto& f : futs)
+        f.get();
+    EXPECT_EQ(order, "hHnlL");  // 通道之间按优先级,通道内部FIFO
+}
+
+TEST(Deadlines, ExpiredTaskIsDroppedWithBrokenPromise) {
+    pool_options opt;
+    opt.metrics = true;
+    ThreadPool<> pool(1, opt);
+    std::atomic<bool> ran{ false };
+    std::future<int> late;
+    std::future<int> on_time;
+    {
+        blocked_worker b{ pool };
+        auto now = task::clock::now();
+        late = pool.submit(priority::normal, now + std::chrono::milliseconds(1), [&ran] { ran.store(true); return 1; });
+        on_time = pool.submit(priority::normal, now + std::chrono::hours(1), [] { return 2; });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));  // worker被占住时late的截止时间过去了
+    }
+    EXPECT_EQ(on_time.get(), 2);
+    try {
+        late.get();
+        FAIL() << "expired task should not produce a value";
+    }
+    catch (const std::future_error& e) {
+        EXPECT_EQ(e.code(), std::future_errc::broken_promise);
+    }
+    EXPECT_FALSE(ran.load());
+    std::uint64_t dropped = 0;
+    for (auto& w : pool.stats().workers)
+        dropped += w.dropped;
+    EXPECT_EQ(dropped, 1u);
+}
+
+TEST(BoundedQueue, RejectPolicyFailsFastWhenFull) {
+    std::atomic<int> ran{ 0 };  // 任务引用的局部变量都声明在pool前面,pool先析构,join完worker它们才离开作用域
+    std::future<void> queued, rejected;
+    bool posted = true;
+    std::optional<std::future<void>> tried;
+    ThreadPool<> pool(1, bounded(overflow_policy::reject));
+    {
+        blocked_worker b{ pool };
+        queued = pool.submit([&ran] { ran.fetch_add(1); });  // 占住唯一的空位
+        rejected = pool.submit([&ran] { ran.fetch_add(100); });
+        posted = pool.post([&ran] { ran.fetch_add(100); });
+        tried = pool.try_submit([&ran] { ran.fetch_add(100); });
+    }
+    queued.get();
+    EXPECT_THROW(rejected.get(), queue_full);
+    EXPECT_FALSE(posted);
+    EXPECT_FALSE(tried.has_value());
+    EXPECT_EQ(ran.load(), 1);
+}
+
+TEST(BoundedQueue, CallerRunsPolicyRunsOnTheSubmitter) {
+    std::thread::id queued_on, overflow_on;
+    std::future<void> queued;
+    ThreadPool<> pool(1, bounded(overflow_policy::caller_runs));
+    {
+        blocked_worker b{ pool };
+        queued = pool.submit([&] { queued_on = std::this_thread::get_id(); });
+        pool.submit([&] { overflow_on = std::this_thread::get_id(); }).get();  // 队列满了: 就在这里执行,不用等worker
+    }
+    queued.get();
+    EXPECT_EQ(overflow_on, std::this_thread::get_id());
+    EXPECT_NE(queued_on, std::this_thread::get_id());
+}
+
+TEST(BoundedQueue, BlockPolicyWaitsForAFreeSlot) {
+    std::atomic<bool> submitted{ false };
+    std::future<int> queued;
+    std::future<int> blocked;
+    ThreadPool<> pool(1, bounded(overflow_policy::block));
+    std::thread submitter;  // 引用着pool,要在pool之后声明,先join
+    {
+        blocked_worker b{ pool };
+        queued = pool.submit([] { return 1; });
+        submitter = std::thread([&] {
+            blocked = pool.submit([] { return 2; });
+            submitted.store(true);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        EXPECT_FALSE(submitted.load());  // 没有空位,提交者睡在信号量上
+        EXPECT_EQ(pool.stats().pending, 1u);
+    }
+    submitter.join();  // worker取走queued之后空位还回来,提交者继续
+    EXPECT_TRUE(submitted.load());
+    EXPECT_EQ(queued.get(), 1);
+    EXPECT_EQ(blocked.get(), 2);
+}
+
+TEST(TaskGraph, ThenPassesValuesAndSkipsSuccessorsOfAFailure) {
+    ThreadPool<> pool(2);
+    auto a = pool.async([] { return 2; });
+    auto b = pool.then(a, [](int x) { return x * 3; });
+    auto v = pool.then(pool.async([] {}), [] { return std::string("void pred"); });
+    std::atomic<int> ran{ 0 };
+    auto c = pool.then(b, [](int) -> int { throw std::runtime_error("boom"); });
+    auto d = pool.then(c, [&](int x) { ran++; return x; });
+    auto e = pool.then(d, [&](int) { ran++; });
+    EXPECT_EQ(b.get(), 6);
+    EXPECT_EQ(v.get(), "void pred");
+    try {
+        e.get();
+        ADD_FAILURE() << "e should rethrow c's exception";
+    }
+    catch (const std::runtime_error& err) {
+        EXPECT_STREQ(err.what(), "boom");
+    }
+    EXPECT_THROW(d.get(), std::runtime_error);
+    EXPECT_EQ(ran.load(), 0);  // 失败之后的后继一个都不执行
+    auto late = pool.then(c, [&](int x) { ran++; return x; });  // 前驱已经失败了再接上去也一样
+    EXPECT_THROW(late.get(), std::runtime_error);
+    EXPECT_EQ(ran.load(), 0);
+}
+
+TEST(TaskGraph, SuccessorsShareTheResultAsConst) {
+    ThreadPool<> pool(4);
+    auto source = pool.async([] { return std::vector<int>(1000, 7); });
+    auto is_const = [](auto& v) { return std::is_const_v<std::remove_reference_t<decltype(v)>>; };  // 泛型lambda按实参推导
+    auto sum = [](const std::vector<int>& v) { return std::accumulate(v.begin(), v.end(), 0); };
+    auto c1 = pool.then(source, is_const);
+    auto c2 = pool.then(source, is_const);
+    auto s1 = pool.then(source, sum);
+    auto s2 = pool.then(source, sum);
+    auto same = pool.then(pool.when_all(s1, s2), [](const auto& t) { return std::get<0>(t) == std::get<1>(t); });
+    EXPECT_TRUE(c1.get());
+    EXPECT_TRUE(c2.get());
+    EXPECT_EQ(s1.get(), 7000);
+    EXPECT_TRUE(same.get());
+    EXPECT_EQ(source.get(), std::vector<int>(1000, 7));  // 后继都没能改动它
+}
+
+TEST(TaskGraph, WhenAllCollectsResultsOrTheFirstErrorInArgumentOrder) {
+    ThreadPool<> pool(4);
+    auto all = pool.when_all(pool.async([] { return 1; }), pool.async([] {}), pool.async([] { return std::string("s"); }));
+    EXPECT_EQ(all.get(), std::make_tuple(1, std::monostate{}, std::string("s")));
+    EXPECT_TRUE(pool.when_all().is_ready());  // 没有前驱时立即完成
+    EXPECT_TRUE(pool.when_all(std::vector<graph_node<int>>{}).get().empty());
+
+    std::promise<void> gate;
+    std::shared_future<void> opened = gate.get_future().share();
+    auto first = pool.async([opened]() -> int { opened.wait(); throw std::runtime_error("first"); });
+    auto second = pool.async([]() -> int { throw std::logic_error("second"); });  // 先失败,但排在后面
+    std::atomic<bool> ran{ false };
+    auto fails = pool.when_all(pool.async([] { return 0; }), first, second);
+    auto after = pool.then(fails, [&](const auto&) { ran = true; });
+    std::vector<graph_node<int>> nodes = { pool.async([] { return 0; }), second, first };
+    auto fails_vec = pool.when_all(nodes);
+    EXPECT_THROW(second.get(), std::logic_error);
+    EXPECT_FALSE(fails.is_ready());  // 所有前驱都完成之前不会提前失败
+    gate.set_value();
+    EXPECT_THROW(fails.get(), std::runtime_error);
+    EXPECT_THROW(after.get(), std::runtime_error);
+    EXPECT_FALSE(ran.load());
+    EXPECT_THROW(fails_vec.get(), std::logic_error);
+
+    std::vector<graph_node<int>> ok;
+    for (int i = 0; i < 100; i++)
+        ok.push_back(pool.async([i] { return i * i; }));
+    auto squares = pool.when_all(ok).get();
+    ASSERT_EQ(squares.size(), 100u);
+    for (int i = 0; i < 100; i++)
+        EXPECT_EQ(squares[size_t(i)], i * i);
+}
+
+TEST(TaskGraph, WhenAnyTakesTheFirstFinisherWhetherItSucceedsOrFails) {
+    ThreadPool<> pool(4);
+    std::promise<void> gate;
+    std::shared_future<void> opened = gate.get_future().share();
+    std::vector<graph_node<int>> nodes = {
+        pool.async([opened]() -> int { opened.wait(); throw std::runtime_error("slow"); }),
+        pool.async([] { return 42; }),
+        pool.async([opened] { opened.wait(); return 7; }),
+    };
+    auto any = pool.when_any(nodes);
+    EXPECT_EQ(any.get(), std::make_pair(size_t(1), 42));
+    gate.set_value();  // 输掉的前驱后来失败也不影响结果
+    EXPECT_THROW(nodes[0].get(), std::runtime_error);
+    EXPECT_EQ(any.get(), std::make_pair(size_t(1), 42));
+
+    std::promise<void> gate2;
+    std::shared_future<void> opened2 = gate2.get_future().share();
+    std::vector<graph_node<int>> racing = {
+        pool.async([opened2] { opened2.wait(); return 1; }),
+        pool.async([]() -> int { throw std::logic_error("fast failure"); }),
+    };
+    auto failed = pool.when_any(racing);
+    EXPECT_THROW(failed.get(), std::logic_error);  // 第一个完成的失败了,when_any就是它的异常
+    gate2.set_value();
+    EXPECT_EQ(racing[0].get(), 1);
+    EXPECT_THROW(failed.get(), std::logic_error);
+
+    EXPECT_THROW(pool.when_any(std::vector<graph_node<int>>{}), std::invalid_argument);
+}
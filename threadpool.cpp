@@ -1,112 +1,10 @@
-#include <chrono>
-#include <condition_variable>
-#include <functional>
-#include <future>
+#include "threadpool.h"
 #include <iostream>
-#include <mutex>
-#include <queue>
-#include <shared_mutex>
-#include <string>
-#include <thread>
-#include <time.h>
-#include <utility>
-#include <vector>
 using namespace std;
 
-template<typename T>
-struct safe_queue {
-    queue<T> q;
-    shared_mutex _m;
-    auto empty() {  // AOP(aspect-oriented-programming), decorator, solidity modifier
-        shared_lock<shared_mutex> lc(_m);
-        return q.empty();
-    }
-    auto size() {
-        shared_lock<shared_mutex> lc(_m);
-        return q.size();
-    }
-    auto push(T& t) {
-        unique_lock<shared_mutex> lc(_m);  // unique_lock vs shared_mutex
-        q.push(t);
-    }
-    auto pop(T& t) {
-        unique_lock<shared_mutex> lc(_m);
-        if (q.empty())
-            return false;
-        t = move(q.front());
-        q.pop();
-        return true;
-    }
-};
-
-class ThreadPool {
-private:
-    class worker {  // 工作线程一旦被创建,会不断地去wait线程池的任务队列是否为空,如果不空会取出队头的任务执行;执行完继续wait
-    public:
-        ThreadPool* pool;
-        worker(ThreadPool* _pool) : pool{ _pool } {}
-        void operator ()() {  // callable ( like lambda / function() )
-            while (!pool->is_shut_down) {
-                {
-                    unique_lock<mutex> lock(pool->_m);  // <- 其他线程阻塞在这里
-                    pool->cv.wait(lock, [this]() {  // <- 只有一个线程阻塞在这里
-                        return (this->pool->is_shut_down) || !this->pool->q.empty();
-                        //     (pool开启的时候,这一项可忽略)
-                    });
-                }
-                function<void()> func;
-                bool flag = pool->q.pop(func);  // 队列中有元素
-                if (flag)
-                    func();
-            }
-        }
-    };
-public:
-    bool is_shut_down;
-    safe_queue<std::function<void()>> q;
-    vector<std::thread> threads;
-    mutex _m;
-    condition_variable cv;
-    ThreadPool(int n): threads(n, thread(worker(this))), is_shut_down{false} {}  // 创建n个thread, 回调函数为 worker()
-    
-    ThreadPool(const ThreadPool&) = delete;
-    ThreadPool(ThreadPool&&) = delete;
-    ThreadPool& operator=(const ThreadPool&) = delete;
-    ThreadPool& operator=(ThreadPool&&) = delete;
-
-    template <typename F, typename... Args>
-    auto submit(F&& f, Args&&...args) -> std::future<decltype(f(args...))> {
-        using return_type = decltype(f(args...));
-        function<return_type()> func = [&f, args...]() {  // bind: f(args...) -> func()  使得函数变成一个无参函数
-            return f(args...);  // 此处未使用完美转发,导致如果传入右值的args会产生拷贝构造的消耗
-        };
-        // 用一个智能指针来管理这个任务(函数)??
-        auto task_ptr = std::make_shared< std::packaged_task<return_type()> >(func);
-        std::function<void()> wrapper_func = [task_ptr]() {  // 使得函数变成一个无返回值函数,这也是一种多态
-            (*task_ptr)();
-        };
-        q.push(wrapper_func);
-        cv.notify_one();
-        // https://zh.cppreference.com/w/cpp/thread/future
-        // => "future<return_type> = packaged_task<return_type()>.get_future()"
-        // 让packaged_task和future类型的返回值绑定,可以通过 返回值.get() 即 future.get() 来获得线程执行的返回值
-        return task_ptr->get_future();
-    }
-    ~ThreadPool() {
-        auto f = submit([]() {});  // 哨兵
-        f.get();  // 说明:最后一个任务被取出,可知任务队列里的所有任务都被取出执行了(是否执行完成不知道,这个由下面的join来保证)
-        is_shut_down = true;  // 关闭线程池(不再有worker进入while循环)
-        cv.notify_all();
-        for (auto& t : threads) {
-            if (t.joinable())
-                t.join();  // 保证每一个worker执行的任务都执行完毕,才结束析构函数,结束程序
-        }
-    }
-};
-
 mutex _m;
 int main() {
-    ThreadPool pool(8);
+    ThreadPool pool(8);  // 等价于 ThreadPool<safe_queue>; 无锁版本: ThreadPool<lockfree_queue> pool(8);
     int n = 20;
     for (int i = 1; i <= n; i++) {
         pool.submit(
@@ -149,4 +47,4 @@ int main() {
         2. 按顺序申请
         3. 减少锁的粒度
         4. 嵌套锁
-*/
\ No newline at end of file
+*/
@@ -0,0 +1,1509 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <queue>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <time.h>
+#include <utility>
+#include <variant>
+#include <vector>
+#include "json.h"
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define THREADPOOL_COROUTINES 1  // C++20: pool.schedule()可以co_await, task<T>等在coro.h里
+#endif
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(__cpp_lib_hardware_interference_size) && (!defined(__GNUC__) || defined(__clang__))
+inline constexpr size_t cache_line = std::hardware_destructive_interference_size;
+#else
+inline constexpr size_t cache_line = 64;  // GCC在头文件里用hardware_destructive_interference_size会报-Winterference-size(值随-mtune变化),这里直接写死
+#endif
+
+template<typename T>
+struct safe_queue {
+    std::queue<T> q;
+    std::shared_mutex _m;
+    auto empty() {  // AOP(aspect-oriented-programming), decorator, solidity modifier
+        std::shared_lock<std::shared_mutex> lc(_m);
+        return q.empty();
+    }
+    auto size() {
+        std::shared_lock<std::shared_mutex> lc(_m);
+        return q.size();
+    }
+    auto push(T& t) {
+        std::unique_lock<std::shared_mutex> lc(_m);  // unique_lock vs shared_mutex
+        q.push(std::move(t));  // 和其他队列一样,push成功后t被移走
+        return true;  // 无界队列永远push成功,返回值是为了和lockfree_queue接口一致
+    }
+    template<typename It>
+    size_t push_bulk(It first, It last) {  // 一次加锁放入一批,返回放入的个数
+        std::unique_lock<std::shared_mutex> lc(_m);
+        size_t n = 0;
+        for (; first != last; ++first, ++n)
+            q.push(std::move(*first));
+        return n;
+    }
+    auto pop(T& t) {
+        std::unique_lock<std::shared_mutex> lc(_m);
+        if (q.empty())
+            return false;
+        t = std::move(q.front());
+        q.pop();
+        return true;
+    }
+};
+
+template<typename T, size_t Capacity = 1024>
+struct lockfree_queue {  // 有界无锁MPMC环形队列(Dmitry Vyukov): 每个槽带一个序号,生产者/消费者各自CAS一个游标,不需要任何锁
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2");
+    static constexpr size_t capacity = Capacity;  // ThreadPool据此给pool_options::capacity设上限
+    struct cell {
+        std::atomic<size_t> seq;  // seq == pos: 槽空闲,可写; seq == pos + 1: 槽已写入,可读
+        T data;
+    };
+    std::unique_ptr<cell[]> buffer;
+    alignas(cache_line) std::atomic<size_t> enqueue_pos;  // 两个游标分别独占一条cache line,生产者和消费者互不干扰
+    alignas(cache_line) std::atomic<size_t> dequeue_pos;
+    lockfree_queue() : buffer{ new cell[Capacity] }, enqueue_pos{ 0 }, dequeue_pos{ 0 } {
+        for (size_t i = 0; i < Capacity; i++)
+            buffer[i].seq.store(i, std::memory_order_relaxed);
+    }
+    auto empty() {  // 只是一个近似值,调用返回时可能已经过期
+        return size() == 0;
+    }
+    auto size() {
+        size_t head = dequeue_pos.load(std::memory_order_relaxed);
+        size_t tail = enqueue_pos.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : size_t{ 0 };
+    }
+    auto push(T& t) {  // 队列满时返回false,此时t保持不变
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        cell* c;
+        while (true) {
+            c = &buffer[pos & (Capacity - 1)];
+            size_t seq = c->seq.load(std::memory_order_acquire);
+            auto dif = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (dif == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;  // 抢到了这个槽
+            }
+            else if (dif < 0)
+                return false;  // 这个槽上一轮的数据还没被取走: 满了
+            else
+                pos = enqueue_pos.load(std::memory_order_relaxed);  // 被别的生产者抢先了,重新读游标
+        }
+        c->data = std::move(t);
+        c->seq.store(pos + 1, std::memory_order_release);  // 发布: 消费者看到seq == pos + 1才会去读data
+        return true;
+    }
+    template<typename It>
+    size_t push_bulk(It first, It last) {  // 本来就无锁,逐个push即可; 满了就停下,返回已经放入的个数
+        size_t n = 0;
+        for (; first != last && push(*first); ++first)
+            ++n;
+        return n;
+    }
+    auto pop(T& t) {
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        cell* c;
+        while (true) {
+            c = &buffer[pos & (Capacity - 1)];
+            size_t seq = c->seq.load(std::memory_order_acquire);
+            auto dif = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+            if (dif == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (dif < 0)
+                return false;  // 空
+            else
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+        }
+        t = std::move(c->data);
+        c->seq.store(pos + Capacity, std::memory_order_release);  // 槽留给下一轮(pos + Capacity)的生产者
+        return true;
+    }
+};
+
+template<typename Q, typename = void>
+struct queue_bound : std::integral_constant<size_t, 0> {};  // 队列最多能放几个元素, 0表示无界
+template<typename Q>
+struct queue_bound<Q, std::void_t<decltype(Q::capacity)>> : std::integral_constant<size_t, Q::capacity> {};
+
+template<typename T>
+struct work_stealing_queue {  // 每个worker私有的双端队列: 自己在尾部push/pop(LIFO,刚产生的任务数据还在cache里),别的worker从头部steal(FIFO,偷走最老的任务)
+    std::deque<T> dq;
+    std::mutex _m;  // 只有owner和偶尔的thief竞争,不会像全局队列那样所有线程抢一把锁
+    auto push(T& t) {
+        std::lock_guard<std::mutex> lc(_m);
+        dq.push_back(std::move(t));
+    }
+    template<typename It>
+    size_t push_bulk(It first, It last) {
+        std::lock_guard<std::mutex> lc(_m);
+        size_t n = 0;
+        for (; first != last; ++first, ++n)
+            dq.push_back(std::move(*first));
+        return n;
+    }
+    auto pop(T& t) {
+        std::lock_guard<std::mutex> lc(_m);
+        if (dq.empty())
+            return false;
+        t = std::move(dq.back());
+        dq.pop_back();
+        return true;
+    }
+    auto steal(T& t) {
+        std::lock_guard<std::mutex> lc(_m);
+        if (dq.empty())
+            return false;
+        t = std::move(dq.front());
+        dq.pop_front();
+        return true;
+    }
+};
+
+class task {  // move-only的可调用对象: 不超过inline_size的callable直接放在对象内部(small buffer),不用new; 比std::function少一次堆分配,也不要求callable可拷贝
+public:
+    static constexpr size_t inline_size = 64;
+    task() = default;
+    template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, task>>>
+    task(F&& f) {
+        using Fn = std::decay_t<F>;
+        if constexpr (fits_inline<Fn>) {
+            new (buf) Fn(std::forward<F>(f));
+            ops = &inline_ops<Fn>;
+        }
+        else {
+            *reinterpret_cast<Fn**>(buf) = new Fn(std::forward<F>(f));  // 太大的callable只好放到堆上,buf里存指针
+            ops = &heap_ops<Fn>;
+        }
+    }
+    task(task&& rhs) noexcept : deadline{ rhs.deadline }, enqueued_at{ rhs.enqueued_at }, ops{ rhs.ops } {
+        if (ops) {
+            ops->move(buf, rhs.buf);
+            rhs.ops = nullptr;
+        }
+    }
+    task& operator=(task&& rhs) noexcept {
+        if (this != &rhs) {
+            reset();
+            deadline = rhs.deadline;
+            enqueued_at = rhs.enqueued_at;
+            if (rhs.ops) {
+                rhs.ops->move(buf, rhs.buf);
+                ops = rhs.ops;
+                rhs.ops = nullptr;
+            }
+        }
+        return *this;
+    }
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+    ~task() { reset(); }
+    explicit operator bool() const { return ops != nullptr; }
+    void operator ()() { ops->invoke(buf); }
+    using clock = std::chrono::steady_clock;
+    clock::time_point deadline = clock::time_point::max();  // 过了截止时间还没开始执行的任务直接丢弃
+    bool expired() const { return deadline != clock::time_point::max() && clock::now() > deadline; }
+    std::uint64_t enqueued_at = 0;  // 入队时的read_ticks(),只在统计打开时设置
+private:
+    struct vtable {  // 手写的"虚函数表",每种callable类型一份,task本身只存一个指针
+        void (*invoke)(void*);
+        void (*move)(void* dst, void* src);  // 把src搬到dst,并析构src
+        void (*destroy)(void*);
+    };
+    template<typename Fn>
+    static constexpr bool fits_inline = sizeof(Fn) <= inline_size && alignof(Fn) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<Fn>;
+    template<typename Fn>
+    inline static const vtable inline_ops = {
+        [](void* p) { (*static_cast<Fn*>(p))(); },
+        [](void* dst, void* src) {
+            new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+            static_cast<Fn*>(src)->~Fn();
+        },
+        [](void* p) { static_cast<Fn*>(p)->~Fn(); },
+    };
+    template<typename Fn>
+    inline static const vtable heap_ops = {
+        [](void* p) { (**static_cast<Fn**>(p))(); },
+        [](void* dst, void* src) { *static_cast<Fn**>(dst) = *static_cast<Fn**>(src); },
+        [](void* p) { delete *static_cast<Fn**>(p); },
+    };
+    void reset() {
+        if (ops) {
+            ops->destroy(buf);
+            ops = nullptr;
+        }
+    }
+    alignas(std::max_align_t) unsigned char buf[inline_size];
+    const vtable* ops = nullptr;
+};
+
+template<size_t Size>
+struct block_pool {  // 线程本地的固定大小内存块空闲链表,给promise/future的共享状态用,避免每次submit都去malloc
+    struct node { node* next; };
+    static constexpr size_t batch = 64;  // 线程本地链表和全局仓库之间一次搬运一批
+    struct depot {  // 所有线程共享: 生产者和消费者不是同一个线程时,块会在释放方堆积,整批交到这里,分配方再整批领走,每批只加一次锁
+        std::mutex _m;
+        std::vector<node*> batches;  // 每个元素是一条长度为batch的链表
+    };
+    node* head;  // 只有平凡析构的成员: 线程退出时别的thread_local析构函数里还可以安全地访问
+    size_t count;
+    bool closed;
+    static block_pool& local() {
+        static thread_local block_pool pool;  // 零初始化
+        static thread_local struct guard {
+            ~guard() {  // 线程退出时把缓存的块还回去,之后的释放直接走operator delete
+                auto& p = pool;
+                while (p.head) {
+                    node* n = p.head;
+                    p.head = n->next;
+                    ::operator delete(n);
+                }
+                p.closed = true;
+            }
+        } g;
+        (void)g;
+        return pool;
+    }
+    static depot& shared() {
+        static depot* d = new depot;  // 故意不析构: 其他线程退出时的释放可能晚于静态对象的析构
+        return *d;
+    }
+    void* allocate() {
+        if (!head) {
+            auto& d = shared();
+            std::lock_guard<std::mutex> lc(d._m);
+            if (!d.batches.empty()) {
+                head = d.batches.back();
+                d.batches.pop_back();
+                count = batch;
+            }
+        }
+        if (head) {
+            node* n = head;
+            head = n->next;
+            --count;
+            return n;
+        }
+        return ::operator new(Size);
+    }
+    void deallocate(void* p) {
+        if (closed) {
+            ::operator delete(p);
+            return;
+        }
+        node* n = static_cast<node*>(p);
+        n->next = head;
+        head = n;
+        if (++count < 2 * batch)
+            return;
+        node* first = head;  // 攒够两批了,把前一批交给全局仓库
+        node* last = head;
+        for (size_t i = 1; i < batch; i++)
+            last = last->next;
+        head = last->next;
+        last->next = nullptr;
+        count -= batch;
+        auto& d = shared();
+        std::lock_guard<std::mutex> lc(d._m);
+        d.batches.push_back(first);
+    }
+};
+
+template<typename T>
+struct pool_allocator {  // 把单个对象的分配转给对应大小的block_pool; promise(allocator_arg, alloc)会用它分配共享状态
+    using value_type = T;
+    pool_allocator() = default;
+    template<typename U>
+    pool_allocator(const pool_allocator<U>&) {}
+    static constexpr size_t block_size = (sizeof(T) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+    T* allocate(size_t n) {
+        if (n == 1 && alignof(T) <= alignof(std::max_align_t))
+            return static_cast<T*>(block_pool<block_size>::local().allocate());
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T* p, size_t n) {
+        if (n == 1 && alignof(T) <= alignof(std::max_align_t))
+            block_pool<block_size>::local().deallocate(p);
+        else
+            std::allocator<T>().deallocate(p, n);
+    }
+    template<typename U>
+    bool operator ==(const pool_allocator<U>&) const { return true; }
+    template<typename U>
+    bool operator !=(const pool_allocator<U>&) const { return false; }
+};
+
+inline void cpu_relax() {  // 忙等循环里用: 告诉CPU这是自旋,降低功耗,也让超线程的另一半跑得更快
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+inline std::uint64_t read_ticks() {  // 统计用的时间戳: x86上直接读TSC(十几个周期),其他平台退回steady_clock的纳秒数
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+struct latency_histogram {  // 按2的幂分桶: 第i个桶统计落在[2^i, 2^(i+1))个tick里的样本
+    static constexpr size_t num_buckets = 48;
+    std::atomic<std::uint64_t> buckets[num_buckets] = {};
+    void record(std::uint64_t ticks) {
+        size_t b = 0;
+#if defined(__GNUC__)
+        if (ticks)
+            b = 63 - __builtin_clzll(ticks);
+#else
+        while (ticks >>= 1)
+            ++b;
+#endif
+        buckets[std::min(b, num_buckets - 1)].fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+struct alignas(cache_line) worker_metrics {  // 每个worker一份,独占cache line,全部是relaxed原子操作; 只在pool_options::metrics打开时更新
+    std::atomic<std::uint64_t> executed{ 0 };
+    std::atomic<std::uint64_t> stolen{ 0 };   // 从别的worker本地队列偷来的任务数
+    std::atomic<std::uint64_t> dropped{ 0 };  // 过了deadline被丢弃的任务数
+    std::atomic<std::uint64_t> parked{ 0 };   // 睡眠的次数
+    std::atomic<std::uint64_t> busy_ticks{ 0 };
+    std::atomic<std::uint64_t> idle_ticks{ 0 };
+    latency_histogram wait;  // 任务从入队到开始执行
+    latency_histogram run;   // 任务执行耗时
+};
+
+struct worker_stats {
+    std::uint64_t executed, stolen, dropped, parked;
+    double busy_ns, idle_ns;
+    double busy_ratio() const { return busy_ns + idle_ns > 0 ? busy_ns / (busy_ns + idle_ns) : 0; }
+};
+
+struct histogram_stats {  // 快照: buckets[i]是延迟小于upper_ns(i)的样本数(减去前面的桶)
+    std::vector<std::uint64_t> buckets;
+    double ns_per_tick;
+    double upper_ns(size_t i) const { return double(std::uint64_t(2) << i) * ns_per_tick; }
+    std::uint64_t count() const {
+        std::uint64_t n = 0;
+        for (auto b : buckets)
+            n += b;
+        return n;
+    }
+    double percentile(double p) const {  // 返回所在桶的上界,精度是2倍以内
+        std::uint64_t total = count(), seen = 0;
+        for (size_t i = 0; i < buckets.size(); i++) {
+            seen += buckets[i];
+            if (total && seen >= p * total)
+                return upper_ns(i);
+        }
+        return 0;
+    }
+    json::Node to_json() const {
+        json::Array b;
+        size_t last = buckets.size();
+        while (last > 0 && buckets[last - 1] == 0)
+            --last;
+        for (size_t i = 0; i < last; i++)
+            b.push_back(json::Node(json::Int(buckets[i])));
+        json::Object o;
+        o["count"] = json::Node(json::Int(count()));
+        o["p50_ns"] = json::Node(percentile(0.5));
+        o["p99_ns"] = json::Node(percentile(0.99));
+        o["buckets"] = json::Node(std::move(b));  // 第i个元素对应 < 2^(i+1)个tick
+        return json::Node(std::move(o));
+    }
+};
+
+struct pool_stats {  // pool.stats()返回的快照; 计数器是各自独立读的,彼此之间不保证是同一时刻
+    size_t pending, peak_pending;
+    std::vector<size_t> lane_depth;  // 各优先级通道当前的长度(近似值)
+    std::vector<worker_stats> workers;  // 最后一项是非worker线程(parallel_for的调用者)帮忙执行的任务
+    histogram_stats wait, run;
+    json::Node to_json() const {  // 配合json::generate输出
+        json::Object o;
+        o["pending"] = json::Node(json::Int(pending));
+        o["peak_pending"] = json::Node(json::Int(peak_pending));
+        json::Array lanes;
+        for (auto d : lane_depth)
+            lanes.push_back(json::Node(json::Int(d)));
+        o["lanes"] = json::Node(std::move(lanes));
+        json::Array ws;
+        for (auto& w : workers) {
+            json::Object wo;
+            wo["executed"] = json::Node(json::Int(w.executed));
+            wo["stolen"] = json::Node(json::Int(w.stolen));
+            wo["dropped"] = json::Node(json::Int(w.dropped));
+            wo["parked"] = json::Node(json::Int(w.parked));
+            wo["busy_ns"] = json::Node(w.busy_ns);
+            wo["idle_ns"] = json::Node(w.idle_ns);
+            wo["busy_ratio"] = json::Node(w.busy_ratio());
+            ws.push_back(json::Node(std::move(wo)));
+        }
+        o["workers"] = json::Node(std::move(ws));
+        o["wait"] = wait.to_json();
+        o["run"] = run.to_json();
+        return json::Node(std::move(o));
+    }
+};
+
+class semaphore {  // C++17还没有std::counting_semaphore: 计数用原子变量,只有真的需要睡眠/唤醒时才碰mutex+condition_variable(Linux上底层就是futex)
+public:
+    explicit semaphore(std::ptrdiff_t initial = 0) : count{ initial } {}
+    void release(std::ptrdiff_t n = 1) {
+        std::ptrdiff_t old = count.fetch_add(n, std::memory_order_release);
+        if (old >= 0)
+            return;  // 没有人在等
+        std::ptrdiff_t waiters = std::min(-old, n);
+        {
+            std::lock_guard<std::mutex> lc(_m);
+            signals += waiters;
+        }
+        if (waiters == 1)
+            cv.notify_one();
+        else
+            cv.notify_all();
+    }
+    void acquire() {
+        if (count.fetch_sub(1, std::memory_order_acquire) > 0)
+            return;  // 快速路径: 不加锁
+        std::unique_lock<std::mutex> lc(_m);
+        cv.wait(lc, [this]() { return signals > 0; });
+        --signals;
+    }
+    bool try_acquire() {
+        std::ptrdiff_t c = count.load(std::memory_order_relaxed);
+        while (c > 0) {
+            if (count.compare_exchange_weak(c, c - 1, std::memory_order_acquire, std::memory_order_relaxed))
+                return true;
+        }
+        return false;
+    }
+private:
+    std::atomic<std::ptrdiff_t> count;  // < 0 时,绝对值就是正在(或即将)睡眠的线程数
+    std::mutex _m;
+    std::condition_variable cv;
+    std::ptrdiff_t signals = 0;  // 已经发出但还没被领走的唤醒
+};
+
+enum class priority {  // 固定的几条优先级通道,每条是独立的FIFO队列,没有全局堆,也就没有一把所有人都要抢的锁
+    high,    // 交互式/延迟敏感: worker总是先看这条
+    normal,  // 默认
+    low,     // 后台批处理: 其他队列都空了才轮到
+};
+constexpr size_t num_priorities = 3;
+
+struct cpu_topology {  // 机器的NUMA拓扑: Linux上读/sys/devices/system/node,读不到就当成只有一个节点
+    std::vector<std::vector<int>> node_cpus;  // 每个节点上的cpu编号
+    std::vector<int> cpu_node;  // cpu编号 -> 节点下标(node_cpus的下标)
+    static const cpu_topology& get() {
+        static const cpu_topology topo = detect();
+        return topo;
+    }
+    int node_of(int cpu) const { return cpu >= 0 && size_t(cpu) < cpu_node.size() ? cpu_node[cpu] : 0; }
+    static int current_cpu() {
+#if defined(__linux__)
+        return sched_getcpu();
+#else
+        return -1;
+#endif
+    }
+private:
+    static std::vector<int> parse_cpulist(const std::string& list) {  // "0-3,8-11"
+        std::vector<int> cpus;
+        size_t pos = 0;
+        while (pos < list.size()) {
+            size_t end = list.find(',', pos);
+            if (end == std::string::npos)
+                end = list.size();
+            std::string item = list.substr(pos, end - pos);
+            size_t dash = item.find('-');
+            try {
+                int lo = std::stoi(item.substr(0, dash));
+                int hi = dash == std::string::npos ? lo : std::stoi(item.substr(dash + 1));
+                for (int c = lo; c <= hi; c++)
+                    cpus.push_back(c);
+            }
+            catch (...) {}  // 空行或者格式不对就跳过
+            pos = end + 1;
+        }
+        return cpus;
+    }
+    static cpu_topology detect() {
+        cpu_topology t;
+#if defined(__linux__)
+        for (int node = 0; node < 1024; node++) {
+            std::ifstream fin("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (!fin) {
+                if (node > 64 || !t.node_cpus.empty())  // 节点编号可能不连续,但不会离谱
+                    break;
+                continue;
+            }
+            std::string list;
+            std::getline(fin, list);
+            auto cpus = parse_cpulist(list);
+            if (!cpus.empty())
+                t.node_cpus.push_back(std::move(cpus));
+        }
+#endif
+        if (t.node_cpus.empty()) {
+            t.node_cpus.emplace_back();
+            for (unsigned c = 0; c < std::max(1u, std::thread::hardware_concurrency()); c++)
+                t.node_cpus[0].push_back(int(c));
+        }
+        for (size_t n = 0; n < t.node_cpus.size(); n++) {
+            for (int c : t.node_cpus[n]) {
+                if (size_t(c) >= t.cpu_node.size())
+                    t.cpu_node.resize(c + 1, 0);
+                t.cpu_node[c] = int(n);
+            }
+        }
+        return t;
+    }
+};
+
+inline bool pin_this_thread(const std::vector<int>& cpus) {  // 把调用线程绑定到cpus里的核上; 不支持的平台什么都不做,返回false
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int c : cpus)
+        if (c >= 0 && c < CPU_SETSIZE)
+            CPU_SET(c, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+enum class placement {  // worker线程放在哪里
+    none,        // 不绑定,由操作系统调度
+    cores,       // 每个worker绑一个核,按NUMA节点依次排开(先排满节点0,再节点1...)
+    numa_nodes,  // 每个worker绑到一个NUMA节点的所有核上,worker轮流分配到各个节点; 节点内由操作系统调度
+};
+
+enum class overflow_policy {  // 队列满了(pool_options::capacity)之后,外部线程再提交任务时怎么办
+    block,        // 提交者在信号量上睡眠,直到有worker取走任务腾出空位
+    reject,       // submit返回一个带queue_full异常的future, post返回false
+    caller_runs,  // 提交者自己就地执行这个任务,天然限速
+};
+
+struct queue_full : std::runtime_error {
+    queue_full() : std::runtime_error("thread pool queue is full") {}
+};
+
+struct pool_options {
+    bool work_stealing = false;  // 默认关闭: 所有任务都走全局队列,行为和以前一样
+    // 空闲策略: 没有任务时先自旋spin_count次,再yield yield_count次,最后才在自己的信号量上睡眠
+    // 自旋越久,安静一段时间后的第一个任务延迟越低,代价是空转的CPU
+    unsigned spin_count = 128;
+    unsigned yield_count = 8;
+    // 任务队列的上限(所有优先级通道和本地队列加起来),0表示无界; worker自己提交的任务遇到满队列时总是就地执行,不会阻塞也不会被拒绝
+    // 有界的全局队列(lockfree_queue)不会超过环的大小: 0或者更大的值都按环的大小算,环满了和队列满了一样按on_full处理
+    size_t capacity = 0;
+    overflow_policy on_full = overflow_policy::block;
+    bool metrics = false;  // 打开后统计每个worker的计数器和排队/执行延迟,通过pool.stats()读取; 关闭时只多一个分支
+    placement pin = placement::none;
+    std::vector<int> cpus;  // 非空时worker i绑定到cpus[i % cpus.size()],优先于pin
+    // 每个NUMA节点一套优先级通道: 外部线程提交的任务进它当前所在节点的队列,worker先取本节点的,空了才去拿别的节点的
+    // 只有worker的位置确定(pin不是none或者给了cpus)时才有意义,否则所有worker都算节点0
+    bool per_node_queues = false;
+};
+
+// ---------------- 任务图(DAG) ----------------
+// pool.async(f)得到一个graph_node; pool.then(node, g)在node完成之后才把g交给线程池,when_all/when_any等若干个node
+// 依赖关系靠每个node上的完成回调和原子计数器推进,前驱全部完成的那一刻后继才入队,没有任何worker阻塞在中间结果上
+
+template<typename T>
+using graph_value_t = std::conditional_t<std::is_void_v<T>, std::monostate, T>;  // void的结果存成monostate,when_all的tuple里也是它
+
+template<typename T>
+struct graph_state {  // 一个node的结果和等它完成的回调; 回调在完成它的那个线程上执行,只做计数和入队,不执行用户代码
+    std::mutex m;
+    std::condition_variable cv;  // 只给外部线程的wait()/get()用
+    bool ready = false;
+    std::optional<graph_value_t<T>> value;
+    std::exception_ptr error;
+    std::vector<task> continuations;
+
+    void on_ready(task t) {  // 已经完成时立即在当前线程上执行
+        {
+            std::unique_lock<std::mutex> lc(m);
+            if (!ready) {
+                continuations.push_back(std::move(t));
+                return;
+            }
+        }
+        t();
+    }
+    template<typename F>
+    void run(F&& f) {  // 执行f,把返回值或者异常作为这个node的结果
+        try {
+            if constexpr (std::is_void_v<T>) {
+                f();
+                complete(std::monostate{});
+            }
+            else
+                complete(f());
+        }
+        catch (...) {
+            fail(std::current_exception());
+        }
+    }
+    template<typename V>
+    void complete(V&& v) {
+        std::unique_lock<std::mutex> lc(m);
+        value.emplace(std::forward<V>(v));
+        finish(lc);
+    }
+    void fail(std::exception_ptr e) {
+        std::unique_lock<std::mutex> lc(m);
+        error = std::move(e);
+        finish(lc);
+    }
+private:
+    void finish(std::unique_lock<std::mutex>& lc) {
+        ready = true;  // 之后value/error不再改变,回调和后继可以不加锁读
+        std::vector<task> ts;
+        ts.swap(continuations);
+        cv.notify_all();
+        lc.unlock();
+        for (auto& t : ts)
+            t();
+    }
+};
+
+template<typename T>
+class graph_node {  // 可以复制,同一个node可以是多个后继的前驱; 结果按const引用交给后继
+public:
+    graph_node() = default;
+    bool valid() const { return st != nullptr; }
+    bool is_ready() const {
+        std::unique_lock<std::mutex> lc(st->m);
+        return st->ready;
+    }
+    void wait() const {  // 只给pool外面的线程用; worker里需要结果的话用then接在后面
+        std::unique_lock<std::mutex> lc(st->m);
+        st->cv.wait(lc, [this] { return st->ready; });
+    }
+    decltype(auto) get() const {  // 等待完成,返回结果的引用或者重新抛出异常
+        wait();
+        if (st->error)
+            std::rethrow_exception(st->error);
+        if constexpr (!std::is_void_v<T>)
+            return static_cast<const T&>(*st->value);
+    }
+
+private:
+    template<template<typename> class Queue>
+    friend class ThreadPool;
+    explicit graph_node(std::shared_ptr<graph_state<T>> _st) : st(std::move(_st)) {}
+    std::shared_ptr<graph_state<T>> st;
+};
+
+template<template<typename> class Queue = safe_queue>  // 全局(注入)队列的实现: safe_queue(有锁,无界) 或者 lockfree_queue(无锁,有界)
+class ThreadPool {
+private:
+    class worker {  // 工作线程一旦被创建,会不断地去取任务执行;取不到就按空闲策略 自旋 -> yield -> 睡眠,直到有人提交任务把它叫醒
+    public:
+        ThreadPool* pool;
+        size_t id;
+        worker(ThreadPool* _pool, size_t _id) : pool{ _pool }, id{ _id } {}
+        void operator ()() {  // callable ( like lambda / function() )
+            if (pool->placed())  // 先绑核再做别的: 之后本线程第一次写到的内存(栈上新用到的页,任务里分配的内存)按first-touch落在本节点
+                pin_this_thread(pool->placement_of(id));
+            current_pool = pool;  // 记录"我是哪个pool的第几个worker",submit据此决定任务放进本地队列还是全局队列
+            current_id = id;
+            std::uint64_t idle_since = pool->opt.metrics ? read_ticks() : 0;
+            while (true) {
+                task func;
+                if (pool->pop_task(id, func)) {  // 本地队列 -> 全局队列 -> 偷别人的
+                    if (pool->opt.metrics) {
+                        pool->metrics[id]->idle_ticks.fetch_add(read_ticks() - idle_since, std::memory_order_relaxed);
+                        idle_since = pool->execute(func, id);
+                    }
+                    else
+                        pool->execute(func, id);
+                    continue;
+                }
+                if (pool->is_shut_down && pool->pending == 0)  // 关闭时也要把本地队列里剩下的任务跑完
+                    break;
+                if (!idle_wait())
+                    pool->park(id);
+            }
+        }
+    private:
+        bool idle_wait() {  // 短时间内等到新任务就返回true,不用睡眠
+            for (unsigned i = 0; i < pool->opt.spin_count; i++) {
+                if (pool->pending.load(std::memory_order_relaxed) > 0)
+                    return true;
+                cpu_relax();
+            }
+            for (unsigned i = 0; i < pool->opt.yield_count; i++) {
+                if (pool->pending.load(std::memory_order_relaxed) > 0)
+                    return true;
+                std::this_thread::yield();
+            }
+            return false;
+        }
+    };
+    inline static thread_local ThreadPool* current_pool = nullptr;
+    inline static thread_local size_t current_id = 0;
+
+    std::uint64_t execute(task& t, size_t id) {  // id: 记到哪个worker_metrics上; 返回执行结束的时间戳(统计关闭时为0)
+        if (!opt.metrics) {
+            if (!t.expired())
+                t();  // 过期的任务不执行,析构时它的promise会让future.get()抛出broken_promise
+            return 0;
+        }
+        auto& m = *metrics[id];
+        std::uint64_t start = read_ticks();
+        if (t.expired()) {
+            m.dropped.fetch_add(1, std::memory_order_relaxed);
+            return start;
+        }
+        m.wait.record(start - t.enqueued_at);
+        t();
+        std::uint64_t end = read_ticks();
+        m.run.record(end - start);
+        m.busy_ticks.fetch_add(end - start, std::memory_order_relaxed);
+        m.executed.fetch_add(1, std::memory_order_relaxed);
+        return end;
+    }
+
+    void stamp(task& t) {
+        if (opt.metrics) {
+            t.enqueued_at = read_ticks();
+            size_t now = pending.load(std::memory_order_relaxed), peak = peak_pending.load(std::memory_order_relaxed);
+            while (now > peak && !peak_pending.compare_exchange_weak(peak, now, std::memory_order_relaxed))
+                ;
+        }
+    }
+
+    struct alignas(cache_line) node_queues {  // 一个NUMA节点上的所有优先级通道
+        std::array<Queue<task>, num_priorities> lanes;
+    };
+
+    size_t caller_node() const {  // 调用线程所在的节点: worker用它被分配的节点,外部线程看它此刻跑在哪个核上
+        if (nodes.size() == 1)
+            return 0;
+        if (current_pool == this)
+            return worker_node[current_id];
+        return size_t(cpu_topology::get().node_of(cpu_topology::current_cpu())) % nodes.size();
+    }
+
+    bool pop_lane(size_t node, priority pr, bool remote, task& func) {  // remote: 本节点之外的其他节点
+        for (size_t i = remote ? 1 : 0; i < (remote ? nodes.size() : 1); i++) {
+            if (nodes[(node + i) % nodes.size()]->lanes[size_t(pr)].pop(func)) {
+                dequeued();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool pop_task(size_t id, task& func) {  // id >= worker数表示调用者不是本pool的worker,没有本地队列
+        // 顺序: 高优先级(先本节点再其他节点) -> 本地队列 -> 本节点普通 -> 偷别人的(都是普通优先级) -> 其他节点普通 -> 低优先级
+        size_t node = id < worker_node.size() ? worker_node[id] : caller_node();
+        if (pop_lane(node, priority::high, false, func) || pop_lane(node, priority::high, true, func))
+            return true;
+        if (id < local_queues.size() && local_queues[id]->pop(func)) {
+            dequeued();
+            return true;
+        }
+        if (pop_lane(node, priority::normal, false, func))
+            return true;
+        for (size_t i = 1; i <= local_queues.size(); i++) {  // 从右边的邻居开始偷,避免所有空闲worker都去偷同一个
+            size_t victim = (id + i) % local_queues.size();
+            if (victim != id && local_queues[victim]->steal(func)) {
+                dequeued();
+                if (opt.metrics)
+                    metrics[std::min(id, threads.size())]->stolen.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return pop_lane(node, priority::normal, true, func) || pop_lane(node, priority::low, false, func) || pop_lane(node, priority::low, true, func);
+    }
+
+    struct alignas(cache_line) parker {  // 每个worker一个信号量,独占cache line; 唤醒时只叫醒被选中的那一个,不会一群线程醒来抢一个任务
+        semaphore sem;
+    };
+
+    void park(size_t id) {
+        {
+            std::lock_guard<std::mutex> lc(_m);
+            idle.push_back(id);
+            num_idle.fetch_add(1);  // seq_cst: 和提交方的 ++pending / 读num_idle 构成Dekker式的握手
+        }
+        if (pending.load() > 0 || is_shut_down) {  // 登记之后再检查一次,防止登记之前刚好提交的任务没人知道
+            std::lock_guard<std::mutex> lc(_m);
+            auto it = std::find(idle.begin(), idle.end(), id);
+            if (it != idle.end()) {
+                idle.erase(it);
+                num_idle.fetch_sub(1);
+                return;
+            }
+            // 已经被某个提交者选中了,它一定会release我的信号量,下面的acquire会立即返回
+        }
+        if (opt.metrics)
+            metrics[id]->parked.fetch_add(1, std::memory_order_relaxed);
+        parkers[id]->sem.acquire();
+    }
+
+    void wake(size_t n) {  // 每个新任务至多叫醒一个睡着的worker; 没人睡觉时连锁都不用加
+        while (n > 0 && num_idle.load() > 0) {
+            size_t id;
+            {
+                std::lock_guard<std::mutex> lc(_m);
+                if (idle.empty())
+                    return;
+                id = idle.back();  // LIFO: 最近才睡下的worker,cache还是热的
+                idle.pop_back();
+                num_idle.fetch_sub(1);
+            }
+            parkers[id]->sem.release();
+            --n;
+        }
+    }
+
+    void wake_all() {
+        std::vector<size_t> ids;
+        {
+            std::lock_guard<std::mutex> lc(_m);
+            ids.swap(idle);
+            num_idle = 0;
+        }
+        for (auto id : ids)
+            parkers[id]->sem.release();
+    }
+
+    enum class admission { queued, run_here, rejected };
+
+    admission admit(bool may_reject) {  // 有容量上限时,每个入队的任务都要先占一个空位(slots),出队时归还
+        if (opt.capacity == 0 || slots.try_acquire())
+            return admission::queued;
+        if (current_pool == this)  // worker是消费者,阻塞在满队列上可能谁都不消费了; 它产生的子任务也不能丢: 就地执行
+            return admission::run_here;
+        switch (opt.on_full) {
+            case overflow_policy::block:
+                slots.acquire();  // 睡在信号量上,而不是轮询size()
+                return admission::queued;
+            case overflow_policy::reject:
+                return may_reject ? admission::rejected : admission::run_here;
+            default:
+                return admission::run_here;
+        }
+    }
+
+    admission admit_batched(std::vector<task>& ts, bool may_reject) {  // 批量提交时: 要阻塞之前先把已经占到空位的任务入队,否则自己占着空位等空位
+        if (opt.capacity == 0 || slots.try_acquire())
+            return admission::queued;
+        push_tasks(ts);
+        ts.clear();
+        return admit(may_reject);
+    }
+
+    void dispatch(admission a, task&& t, priority pr = priority::normal) {
+        if (a == admission::queued)
+            push_task(std::move(t), pr);
+        else if (!t.expired())
+            t();
+    }
+
+    void dequeued(size_t n = 1) {  // 任务离开队列: 计数减少,空位还给可能被阻塞的提交者
+        pending -= n;
+        if (opt.capacity)
+            slots.release(static_cast<std::ptrdiff_t>(n));
+    }
+
+    template <typename R>
+    static std::future<R> rejected_future() {
+        std::promise<R> p(std::allocator_arg, pool_allocator<int>{});
+        p.set_exception(std::make_exception_ptr(queue_full()));
+        return p.get_future();
+    }
+
+    // 无参无返回值的task,这也是一种多态; 调用者已经通过admit占好了空位
+    // 有界队列满了时worker默认就地执行t; run_if_full = false时改为归还空位,t原样留给调用者,返回false
+    bool push_task(task&& t, priority pr = priority::normal, bool run_if_full = true) {
+        ++pending;  // 先计数再入队: worker看到pending>0却pop失败只会多转一圈,反过来则可能计数下溢
+        stamp(t);
+        auto& lane = nodes[caller_node()]->lanes[size_t(pr)];
+        if (pr == priority::normal && current_pool == this && !local_queues.empty())
+            local_queues[current_id]->push(t);  // 任务里再submit的子任务放进自己的本地队列; 高/低优先级必须进共享通道,否则别人看不到它的优先级
+        else if (!lane.push(t)) {  // 只有有界队列(lockfree_queue)会push失败
+            // 排队的任务数不超过capacity,capacity又不超过环的大小: 经过admit占到空位的提交不会遇到满的环,下面只是兜底
+            if (current_pool == this) {  // worker自己就地执行,否则所有worker都卡在满队列上就没人消费了
+                dequeued();
+                if (!run_if_full)
+                    return false;
+                execute(t, current_id);
+            }
+            else {
+                wake(1);  // 先确保有worker醒着在消费
+                while (!lane.push(t))  // 外部线程让出CPU,等worker取走一些
+                    std::this_thread::yield();
+            }
+        }
+        wake(1);
+        return true;
+    }
+
+    void push_tasks(std::vector<task>& ts) {  // 整批入队: 每个队列只加一次锁,最后统一唤醒
+        if (ts.empty())
+            return;
+        pending += ts.size();
+        for (auto& t : ts)
+            stamp(t);
+        if (current_pool == this && !local_queues.empty())
+            local_queues[current_id]->push_bulk(ts.begin(), ts.end());
+        else {
+            auto& lane = nodes[caller_node()]->lanes[size_t(priority::normal)];
+            size_t done = lane.push_bulk(ts.begin(), ts.end());
+            while (done < ts.size()) {  // 有界队列放不下了,同push_task
+                if (current_pool == this) {
+                    dequeued(ts.size() - done);
+                    for (; done < ts.size(); done++)
+                        execute(ts[done], current_id);
+                    break;
+                }
+                wake(done);  // 已经入队的先让worker开始消费,否则没人腾位置
+                std::this_thread::yield();
+                done += lane.push_bulk(ts.begin() + done, ts.end());
+            }
+        }
+        wake(ts.size());
+    }
+
+    template <typename F, typename... Args>
+    static auto make_task(F&& f, Args&&...args) {  // 打包成task,同时返回与之绑定的future
+        using return_type = std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>;
+        // 共享状态从线程本地的block_pool里分配,不再是make_shared<packaged_task>
+        std::promise<return_type> p(std::allocator_arg, pool_allocator<int>{});
+        auto fut = p.get_future();
+        // f和args完美转发进lambda(右值移动,左值拷贝),执行时再作为右值交给f,和std::thread/std::async的语义一致
+        task t([p = std::move(p), func = std::forward<F>(f), tup = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+            try {
+                if constexpr (std::is_void_v<return_type>) {
+                    std::apply(std::move(func), std::move(tup));
+                    p.set_value();
+                }
+                else {
+                    p.set_value(std::apply(std::move(func), std::move(tup)));
+                }
+            }
+            catch (...) {
+                p.set_exception(std::current_exception());
+            }
+        });
+        return std::make_pair(std::move(t), std::move(fut));
+    }
+
+    template <typename F, typename... Args>
+    static auto make_post_task(F&& f, Args&&...args) {  // 不需要返回值的任务: 没有promise,也就没有共享状态
+        if constexpr (sizeof...(Args) == 0)
+            return task(std::forward<F>(f));
+        else
+            return task([func = std::forward<F>(f), tup = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+                std::apply(std::move(func), std::move(tup));
+            });
+    }
+    template <typename R, typename F>
+    void run_node(const std::shared_ptr<graph_state<R>>& st, F&& f) {  // 把f交给线程池,结果写进st; 被reject策略拒绝时st就是queue_full
+        if (!post([st, func = std::forward<F>(f)]() mutable { st->run(func); }))
+            st->fail(std::make_exception_ptr(queue_full{}));
+    }
+    bool run_one() {  // 在调用线程上执行一个排队中的任务,parallel_for的调用者等待时用它来帮忙而不是干等
+        task t;
+        size_t id = current_pool == this ? current_id : threads.size();
+        if (!pop_task(id, t))
+            return false;
+        execute(t, id);
+        return true;
+    }
+
+    struct loop_state {  // 一次parallel_for的共享状态; 放在堆上,晚启动的helper任务看到没有剩余块就直接退出,不会访问已经返回的调用者栈
+        size_t nchunks;
+        std::atomic<size_t> next{ 0 };  // 下一个待领取的块(非work_stealing模式)
+        std::atomic<size_t> remaining;  // 还没做完的块
+        std::atomic<bool> failed{ false };
+        std::exception_ptr error;
+        loop_state(size_t n) : nchunks{ n }, remaining{ n } {}
+    };
+
+    template <typename ChunkFn>
+    void run_chunk(loop_state& st, ChunkFn& fn, size_t c) {
+        if (!st.failed.load(std::memory_order_relaxed)) {
+            try {
+                fn(c);
+            }
+            catch (...) {
+                if (!st.failed.exchange(true))
+                    st.error = std::current_exception();  // 只保留第一个异常,其余的块跳过
+            }
+        }
+        st.remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    template <typename ChunkFn>
+    void split_chunks(const std::shared_ptr<loop_state>& st, ChunkFn* fn, size_t lo, size_t hi) {
+        // 递归二分: 右半边作为新任务放进本地队列等别人来偷,自己继续处理左半边;
+        // 队列里已经有足够多的任务时不再细分,剩下的直接顺序执行,省掉任务开销
+        while (hi - lo > 1 && pending < 2 * threads.size()) {
+            auto a = admit(false);
+            if (a != admission::queued)
+                break;  // 队列满了: 不再细分,剩下的自己做
+            size_t mid = lo + (hi - lo) / 2;
+            push_task(make_post_task([this, st, fn, mid, hi]() { split_chunks(st, fn, mid, hi); }));
+            hi = mid;
+        }
+        for (; lo < hi; lo++)
+            run_chunk(*st, *fn, lo);
+    }
+
+    template <typename ChunkFn>
+    void for_each_chunk(size_t nchunks, ChunkFn&& fn) {  // 对[0, nchunks)的每个块调用fn(c),调用线程也参与执行,返回时所有块都已完成
+        if (nchunks == 0)
+            return;
+        auto st = std::make_shared<loop_state>(nchunks);
+        if (!local_queues.empty()) {
+            split_chunks(st, &fn, 0, nchunks);
+        }
+        else {  // 没有work stealing: 所有参与者从同一个原子计数器里动态领块,快的线程自然多做
+            auto claim = [this, st, f = &fn]() {
+                for (size_t c; (c = st->next.fetch_add(1, std::memory_order_relaxed)) < st->nchunks;)
+                    run_chunk(*st, *f, c);
+            };
+            size_t helpers = std::min(threads.size(), nchunks - 1);
+            std::vector<task> ts;
+            for (size_t i = 0; i < helpers; i++) {
+                if (admit_batched(ts, false) != admission::queued)
+                    break;  // 队列满了就少几个helper,调用者自己多领几块
+                ts.push_back(task(claim));
+            }
+            push_tasks(ts);
+            claim();
+        }
+        while (st->remaining.load(std::memory_order_acquire) > 0) {  // fn在调用者栈上: 必须等所有块做完才能返回
+            if (!run_one())
+                std::this_thread::yield();
+        }
+        if (st->error) {
+            auto e = std::move(st->error);  // 晚结束的helper可能还持有st,异常对象不能跟着它在别的线程上释放
+            std::rethrow_exception(e);
+        }
+    }
+
+    template <typename Index>
+    size_t chunk_count(Index begin, Index end, Index& grain) {
+        if (end <= begin)
+            return 0;
+        size_t n = static_cast<size_t>(end - begin);
+        if (grain <= 0)  // 0表示自动: 每个线程大约分到8块
+            grain = static_cast<Index>(std::max<size_t>(1, n / (threads.size() * 8)));
+        return (n + static_cast<size_t>(grain) - 1) / static_cast<size_t>(grain);
+    }
+
+    template <typename Range, typename E>
+    static decltype(auto) element_forward(E& e) {  // 右值range里的元素可以移走,左值range里的只能拷贝
+        if constexpr (std::is_lvalue_reference_v<Range>)
+            return static_cast<const E&>(e);
+        else
+            return std::move(e);
+    }
+    static pool_options bounded_by_queue(pool_options o) {  // 环满了push会失败: 让slots先满,环满就和队列满一样走on_full
+        constexpr size_t ring = queue_bound<Queue<task>>::value;
+        if (ring != 0 && (o.capacity == 0 || o.capacity > ring))
+            o.capacity = ring;
+        return o;
+    }
+    bool placed() const { return !opt.cpus.empty() || opt.pin != placement::none; }
+    std::vector<int> placement_of(size_t i) const {  // worker i应该绑定的cpu集合,空表示不绑定; 同时决定它属于哪个节点
+        const auto& topo = cpu_topology::get();
+        if (!opt.cpus.empty())
+            return { opt.cpus[i % opt.cpus.size()] };
+        if (opt.pin == placement::cores) {
+            std::vector<int> all;
+            for (auto& cpus : topo.node_cpus)
+                all.insert(all.end(), cpus.begin(), cpus.end());
+            return { all[i % all.size()] };
+        }
+        if (opt.pin == placement::numa_nodes)
+            return topo.node_cpus[i % topo.node_cpus.size()];
+        return {};
+    }
+public:
+    // 读写频繁的共享字段各自占一条cache line,避免 提交者改pending 和 worker读is_shut_down/抢_m 之间的伪共享
+    alignas(cache_line) std::atomic<bool> is_shut_down;
+    alignas(cache_line) std::atomic<size_t> pending;  // 所有队列(全局+本地)里还没被取走的任务数,worker靠它判断要不要醒来
+    // 每个NUMA节点一套优先级通道(per_node_queues关闭时只有一套); work_stealing模式下是外部线程提交任务的注入队列
+    std::vector<std::unique_ptr<node_queues>> nodes;
+    std::vector<size_t> worker_node;  // worker i属于nodes里的哪一个
+    std::vector<std::unique_ptr<work_stealing_queue<task>>> local_queues;  // work_stealing关闭时为空
+    std::vector<std::thread> threads;
+    pool_options opt;
+    std::vector<std::unique_ptr<parker>> parkers;
+    alignas(cache_line) std::mutex _m;  // 保护idle
+    std::vector<size_t> idle;  // 正在睡眠(或者正准备睡眠)的worker
+    std::atomic<size_t> num_idle;
+    alignas(cache_line) semaphore slots;  // 队列剩余的空位,只在opt.capacity > 0时使用
+    std::vector<std::unique_ptr<worker_metrics>> metrics;  // n个worker + 1个给非worker线程
+    alignas(cache_line) std::atomic<size_t> peak_pending{ 0 };
+    std::uint64_t start_ticks;  // 用构造以来经过的tick数和纳秒数换算TSC频率
+    std::chrono::steady_clock::time_point start_time;
+    ThreadPool(int n, pool_options _opt = {}) : is_shut_down{ false }, pending{ 0 }, opt{ bounded_by_queue(std::move(_opt)) }, num_idle{ 0 }, slots{ static_cast<std::ptrdiff_t>(opt.capacity) },
+        start_ticks{ read_ticks() }, start_time{ std::chrono::steady_clock::now() } {
+        const auto& topo = cpu_topology::get();
+        size_t num_nodes = opt.per_node_queues && placed() ? topo.node_cpus.size() : 1;
+        for (size_t i = 0; i < num_nodes; i++)
+            nodes.push_back(std::make_unique<node_queues>());
+        for (int i = 0; i < n; i++)
+            worker_node.push_back(num_nodes > 1 ? size_t(topo.node_of(placement_of(i).front())) : 0);
+        for (int i = 0; i < n; i++)
+            parkers.push_back(std::make_unique<parker>());
+        for (int i = 0; i <= n; i++)
+            metrics.push_back(std::make_unique<worker_metrics>());
+        if (opt.work_stealing) {
+            for (int i = 0; i < n; i++)
+                local_queues.push_back(std::make_unique<work_stealing_queue<task>>());
+        }
+        for (int i = 0; i < n; i++)
+            threads.emplace_back(worker(this, i));  // 创建n个thread, 回调函数为 worker(); 所有成员构造完之后再启动线程,线程自己在入口处绑核
+    }
+    
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool(ThreadPool&&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ThreadPool& operator=(ThreadPool&&) = delete;
+
+    template <typename F, typename... Args>
+    auto submit(F&& f, Args&&...args) -> std::future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>> {
+        return submit(priority::normal, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    template <typename F, typename... Args>
+    auto submit(priority pr, F&& f, Args&&...args) -> std::future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>> {
+        return submit(pr, task::clock::time_point::max(), std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    template <typename F, typename... Args>
+    auto submit(priority pr, task::clock::time_point deadline, F&& f, Args&&...args) -> std::future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>> {
+        // 到deadline还没开始执行就丢弃,这时future.get()抛出future_error(broken_promise); 已经开始执行的任务不会被打断
+        using return_type = std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>;
+        auto a = admit(true);
+        if (a == admission::rejected)
+            return rejected_future<return_type>();
+        auto [t, fut] = make_task(std::forward<F>(f), std::forward<Args>(args)...);
+        t.deadline = deadline;
+        dispatch(a, std::move(t), pr);
+        // https://zh.cppreference.com/w/cpp/thread/future
+        // => "future<return_type> = promise<return_type>.get_future()"
+        // 让promise和future类型的返回值绑定,可以通过 返回值.get() 即 future.get() 来获得线程执行的返回值
+        return std::move(fut);
+    }
+
+    template <typename F, typename... Args>
+    auto try_submit(F&& f, Args&&...args) -> std::optional<std::future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>>> {
+        // 不管on_full是什么策略,队列满了就立即返回nullopt,任务不执行
+        if (opt.capacity && !slots.try_acquire())
+            return std::nullopt;
+        auto [t, fut] = make_task(std::forward<F>(f), std::forward<Args>(args)...);
+        push_task(std::move(t));
+        return std::move(fut);
+    }
+
+    template <typename F, typename... Args>
+    auto post(priority pr, F&& f, Args&&...args) -> std::enable_if_t<std::is_invocable_v<std::decay_t<F>, std::decay_t<Args>...>, bool> {
+        auto a = admit(true);
+        if (a == admission::rejected)
+            return false;
+        dispatch(a, make_post_task(std::forward<F>(f), std::forward<Args>(args)...), pr);
+        return true;
+    }
+
+    template <typename F, typename... Args>
+    auto post(F&& f, Args&&...args) -> std::enable_if_t<std::is_invocable_v<std::decay_t<F>, std::decay_t<Args>...>, bool> {
+        // fire-and-forget: 不关心返回值; 任务抛出的异常没人接,和std::thread一样会terminate; 只有reject策略下队列满了才返回false
+        return post(priority::normal, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+#if defined(THREADPOOL_COROUTINES)
+    struct schedule_awaiter {  // co_await pool.schedule(): 把协程剩下的部分当成一个post任务交给worker继续执行
+        ThreadPool* pool;
+        priority pr;
+        bool await_ready() const noexcept { return false; }
+        // 只有真正入队时才挂起; 队列满了(就地执行或者被reject策略拒绝)返回false,协程直接在当前线程上继续,
+        // 不能像post那样就地调用h.resume(): 那样每跳一次栈就深一层,循环里co_await很快就会栈溢出
+        // 有界的环形队列(lockfree_queue)满了在admit里就体现出来(capacity不超过环的大小); push_task万一还是放不下,同样不能就地执行
+        bool await_suspend(std::coroutine_handle<> h) {
+            if (pool->admit(true) != admission::queued)
+                return false;  // 没有占到空位,不用归还
+            return pool->push_task(make_post_task([h]() { h.resume(); }), pr, false);  // 放不下时push_task已经归还了空位
+        }
+        void await_resume() const noexcept {}
+    };
+    schedule_awaiter schedule(priority pr = priority::normal) { return { this, pr }; }
+#endif
+
+    template <typename Range>
+    auto submit_bulk(Range&& range) {  // range里每个元素是一个无参callable,返回顺序对应的future
+        using F = decltype(*std::begin(range));
+        using return_type = std::invoke_result_t<std::decay_t<F>>;
+        std::vector<std::future<return_type>> futs;
+        std::vector<task> ts;
+        for (auto&& f : range) {
+            auto a = admit_batched(ts, true);
+            if (a == admission::rejected) {
+                futs.push_back(rejected_future<return_type>());
+                continue;
+            }
+            auto [t, fut] = make_task(element_forward<Range>(f));
+            futs.push_back(std::move(fut));
+            if (a == admission::queued)
+                ts.push_back(std::move(t));
+            else
+                t();
+        }
+        push_tasks(ts);
+        return futs;
+    }
+
+    template <typename Range>
+    size_t post_batch(Range&& range) {  // 返回被接受(入队或者就地执行)的任务数
+        std::vector<task> ts;
+        size_t accepted = 0;
+        for (auto&& f : range) {
+            auto a = admit_batched(ts, true);
+            if (a == admission::rejected)
+                continue;
+            ++accepted;
+            if (a == admission::queued)
+                ts.push_back(make_post_task(element_forward<Range>(f)));
+            else
+                make_post_task(element_forward<Range>(f))();
+        }
+        push_tasks(ts);
+        return accepted;
+    }
+
+    template <typename Index, typename Body>
+    void parallel_for(Index begin, Index end, Index grain, Body&& body) {
+        // body(i) 逐个元素调用,或者 body(b, e) 处理一整块[b, e); grain是每块的元素个数,<=0表示自动
+        static_assert(std::is_integral_v<Index>, "parallel_for needs an integral index");
+        size_t nchunks = chunk_count(begin, end, grain);
+        for_each_chunk(nchunks, [&](size_t c) {
+            Index b = begin + static_cast<Index>(c) * grain;
+            Index e = end - b > grain ? b + grain : end;
+            if constexpr (std::is_invocable_v<Body&, Index, Index>)
+                body(b, e);
+            else
+                for (Index i = b; i < e; i++)
+                    body(i);
+        });
+    }
+
+    template <typename Index, typename T, typename Body, typename Combine>
+    T parallel_reduce(Index begin, Index end, Index grain, T identity, Body&& body, Combine&& combine) {
+        // body(b, e) 返回[b, e)的部分结果,或者 body(i) 返回单个元素的值; 各块的部分结果按块的顺序用combine合并,结果是确定的
+        static_assert(std::is_integral_v<Index>, "parallel_reduce needs an integral index");
+        size_t nchunks = chunk_count(begin, end, grain);
+        std::vector<T> partial(nchunks, identity);
+        for_each_chunk(nchunks, [&](size_t c) {
+            Index b = begin + static_cast<Index>(c) * grain;
+            Index e = end - b > grain ? b + grain : end;
+            if constexpr (std::is_invocable_v<Body&, Index, Index>)
+                partial[c] = body(b, e);
+            else
+                for (Index i = b; i < e; i++)
+                    partial[c] = combine(std::move(partial[c]), body(i));
+        });
+        T result = std::move(identity);
+        for (auto& p : partial)
+            result = combine(std::move(result), std::move(p));
+        return result;
+    }
+
+    template <typename F, typename... Args>
+    auto async(F&& f, Args&&...args) -> graph_node<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>> {  // 任务图的起点
+        using R = std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>;
+        auto st = std::make_shared<graph_state<R>>();
+        run_node(st, [func = std::forward<F>(f), tup = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+            return std::apply(std::move(func), std::move(tup));
+        });
+        return graph_node<R>{ st };
+    }
+
+    template <typename T, typename F>
+    auto then(const graph_node<T>& pred, F&& f) {  // pred完成后执行f(pred的结果)(void时是f()); pred失败时f不执行,异常传给后继
+        using R = typename std::conditional_t<std::is_void_v<T>, std::invoke_result<std::decay_t<F>&>, std::invoke_result<std::decay_t<F>&, const graph_value_t<T>&>>::type;
+        auto st = std::make_shared<graph_state<R>>();
+        auto ps = pred.st;
+        ps->on_ready([this, ps, st, func = std::forward<F>(f)]() mutable {
+            if (ps->error) {
+                st->fail(ps->error);
+                return;
+            }
+            run_node(st, [ps, func = std::move(func)]() mutable -> R {
+                if constexpr (std::is_void_v<T>)
+                    return func();
+                else
+                    return func(std::as_const(*ps->value));  // 同一个结果可能同时交给好几个后继,只能读
+            });
+        });
+        return graph_node<R>{ st };
+    }
+
+    template <typename... Ts>
+    auto when_all(const graph_node<Ts>&... preds) {  // 所有前驱都完成后得到它们结果的tuple; 有失败的就是第一个失败的异常
+        using R = std::tuple<graph_value_t<Ts>...>;
+        auto st = std::make_shared<graph_state<R>>();
+        auto states = std::make_tuple(preds.st...);
+        auto finish = [st, states]() {
+            std::exception_ptr err;
+            std::apply([&](const auto&... s) { ((err = err ? err : s->error), ...); }, states);
+            if (err)
+                st->fail(err);
+            else
+                st->complete(std::apply([](const auto&... s) { return R{ *s->value... }; }, states));
+        };
+        if constexpr (sizeof...(Ts) == 0)
+            finish();
+        else {
+            auto remaining = std::make_shared<std::atomic<size_t>>(sizeof...(Ts));
+            (preds.st->on_ready([remaining, finish]() {
+                if (remaining->fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    finish();
+            }), ...);
+        }
+        return graph_node<R>{ st };
+    }
+
+    template <typename T>
+    auto when_all(const std::vector<graph_node<T>>& preds) {  // 个数运行时才知道的版本,结果按preds的顺序
+        using R = std::vector<graph_value_t<T>>;
+        auto st = std::make_shared<graph_state<R>>();
+        auto finish = [st, preds]() {
+            R values;
+            values.reserve(preds.size());
+            for (const auto& p : preds) {
+                if (p.st->error) {
+                    st->fail(p.st->error);
+                    return;
+                }
+                values.push_back(*p.st->value);
+            }
+            st->complete(std::move(values));
+        };
+        if (preds.empty()) {
+            finish();
+            return graph_node<R>{ st };
+        }
+        auto shared_finish = std::make_shared<decltype(finish)>(std::move(finish));  // preds可能很多,不要每个回调都复制一份
+        auto remaining = std::make_shared<std::atomic<size_t>>(preds.size());
+        for (const auto& p : preds) {
+            p.st->on_ready([remaining, shared_finish]() {
+                if (remaining->fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    (*shared_finish)();
+            });
+        }
+        return graph_node<R>{ st };
+    }
+
+    template <typename T>
+    auto when_any(const std::vector<graph_node<T>>& preds) {  // 第一个完成的前驱: (下标, 结果),它失败了就是它的异常
+        if (preds.empty())
+            throw std::invalid_argument("when_any of no nodes");
+        using R = std::pair<size_t, graph_value_t<T>>;
+        auto st = std::make_shared<graph_state<R>>();
+        auto won = std::make_shared<std::atomic<bool>>(false);
+        for (size_t i = 0; i < preds.size(); i++) {
+            auto ps = preds[i].st;
+            ps->on_ready([st, won, ps, i]() {
+                if (won->exchange(true, std::memory_order_acq_rel))
+                    return;
+                if (ps->error)
+                    st->fail(ps->error);
+                else
+                    st->complete(R{ i, *ps->value });
+            });
+        }
+        return graph_node<R>{ st };
+    }
+
+    pool_stats stats() {  // 查看线程状态; 统计没打开时计数器全是0,只有pending/lanes有意义
+        pool_stats st;
+        st.pending = pending.load();
+        st.peak_pending = peak_pending.load(std::memory_order_relaxed);
+        st.lane_depth.assign(num_priorities, 0);
+        for (auto& node : nodes)
+            for (size_t i = 0; i < num_priorities; i++)
+                st.lane_depth[i] += node->lanes[i].size();
+        double elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_time).count();
+        std::uint64_t elapsed_ticks = read_ticks() - start_ticks;
+        double ns_per_tick = elapsed_ticks ? elapsed_ns / elapsed_ticks : 1.0;
+        st.wait = { std::vector<std::uint64_t>(latency_histogram::num_buckets), ns_per_tick };
+        st.run = st.wait;
+        for (auto& m : metrics) {
+            worker_stats w;
+            w.executed = m->executed.load(std::memory_order_relaxed);
+            w.stolen = m->stolen.load(std::memory_order_relaxed);
+            w.dropped = m->dropped.load(std::memory_order_relaxed);
+            w.parked = m->parked.load(std::memory_order_relaxed);
+            w.busy_ns = m->busy_ticks.load(std::memory_order_relaxed) * ns_per_tick;
+            w.idle_ns = m->idle_ticks.load(std::memory_order_relaxed) * ns_per_tick;
+            st.workers.push_back(w);
+            for (size_t i = 0; i < latency_histogram::num_buckets; i++) {
+                st.wait.buckets[i] += m->wait.buckets[i].load(std::memory_order_relaxed);
+                st.run.buckets[i] += m->run.buckets[i].load(std::memory_order_relaxed);
+            }
+        }
+        return st;
+    }
+
+    ~ThreadPool() {
+        auto [sentinel, f] = make_task([]() {});  // 哨兵; 不能被reject策略拒绝
+        dispatch(admit(false), std::move(sentinel));
+        f.get();  // 说明:最后一个任务被取出,可知任务队列里的所有任务都被取出执行了(是否执行完成不知道,这个由下面的join来保证)
+        is_shut_down = true;  // 关闭线程池(不再有worker进入while循环)
+        wake_all();
+        for (auto& t : threads) {
+            if (t.joinable())
+                t.join();  // 保证每一个worker执行的任务都执行完毕,才结束析构函数,结束程序
+        }
+    }
+};
+